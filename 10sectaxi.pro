@@ -30,6 +30,7 @@ SOURCES += \
 	texturemanager.cpp \
 	boundedentity.cpp \
 	entity.cpp \
+	framescheduler.cpp \
 	camera.cpp \
 	spriteentity.cpp \
     carentity.cpp \
@@ -37,7 +38,25 @@ SOURCES += \
     video.cpp \
     houseentity.cpp \
     rectentity.cpp \
-    manentity.cpp
+    manentity.cpp \
+    platform.cpp \
+    randommanager.cpp \
+    initgraph.cpp \
+    inputmanager.cpp \
+    world.cpp \
+    worldbatch.cpp \
+    envapi.cpp \
+    snapshot.cpp \
+    rewindbuffer.cpp \
+    statehash.cpp \
+    components.cpp \
+    entitypool.cpp \
+    name.cpp \
+    entitycommands.cpp \
+    jobsystem.cpp \
+    timerwheel.cpp \
+    script.cpp \
+    carhandling.cpp
 
 OTHER_FILES += \
 	Makefile \
@@ -59,6 +78,7 @@ HEADERS += \
 	texturemanager.h \
 	boundedentity.h \
 	entity.h \
+	framescheduler.h \
 	camera.h \
 	spriteentity.h \
     carentity.h \
@@ -66,4 +86,22 @@ HEADERS += \
     video.h \
     houseentity.h \
     rectentity.h \
-    manentity.h
+    manentity.h \
+    platform.h \
+    randommanager.h \
+    initgraph.h \
+    inputmanager.h \
+    world.h \
+    worldbatch.h \
+    envapi.h \
+    snapshot.h \
+    rewindbuffer.h \
+    statehash.h \
+    components.h \
+    entitypool.h \
+    name.h \
+    entitycommands.h \
+    jobsystem.h \
+    timerwheel.h \
+    script.h \
+    carhandling.h
@@ -7,38 +7,30 @@
 #include "app.h"
 
 #include "audiomanager.h"
-#include "boundedentity.h"
-#include "camera.h"
-#include "carentity.h"
-#include "entitymanager.h"
+#include "entity.h"
 #include "fontmanager.h"
-#include "houseentity.h"
-#include "manentity.h"
+#include "initgraph.h"
+#include "jobsystem.h"
+#include "platform.h"
+#include "randommanager.h"
 #include "playercarentity.h"
+#include "rewindbuffer.h"
 #include "settings.h"
-#include "spriteentity.h"
+#include "statehash.h"
 #include "texturemanager.h"
 #include "useful.h"
 #include "video.h"
+#include "world.h"
 
-#include <emscripten/emscripten.h>
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <sstream>
 
-//------------------------------------------------------------------------------
-// Functions defined in JavaScript in the HTML file
-//------------------------------------------------------------------------------
-
-extern "C" {
-	extern void page_toggleMusic();
-	extern bool page_isMusicEnabled();
-	extern void page_toggleDebug();
-	extern bool page_isDebugEnabled();
-}
-
 //------------------------------------------------------------------------------
 // Application class
 //------------------------------------------------------------------------------
@@ -51,21 +43,21 @@ bool gDebug = false;
 
 Application::Application(const std::vector<std::string> &lrArgs) :
 	mArgs(lrArgs),
+	mHeadless(false),
 	mStartTimeSec(0.0f),
 	mCurrentTimeSec(0.0f),
+	mStepSec(1.0f / 60.0f),
+	mMaxCatchUpSteps(1),
+	mAccumulatorSec(0.0f),
+	mIdleTimeSec(0.0f),
+	mFirstFrameShown(false),
 	mQuit(false),
-	mAreaLeft(0.0f),
-	mAreaRight(0.0f),
-	mAreaTop(0.0f),
-	mAreaBottom(0.0f),
+	mpWorld(nullptr),
+	mpRewindBuffer(nullptr),
+	mpHashLog(nullptr),
+	mRetrySnapshotStep(0),
 	mpMusic(nullptr),
-	mpTestSound(nullptr),
-	mCash(0),
-	mCountdownSec(0.0f),
-	mpCurrentHouse(nullptr),
-	mpCurrentTarget(nullptr),
-	mpArrow(nullptr),
-	mMsgDisplayTimeSec(0.0f)
+	mpTestSound(nullptr)
 {
 	ASSERT(msInstance == nullptr);
 	msInstance = this;
@@ -80,11 +72,17 @@ Application::~Application()
 	ASSERT(msInstance != nullptr);
 	msInstance = nullptr;
 	
-	emscripten_cancel_main_loop();
+	Platform::cancelMainLoop();
 	
 	mpMusic = nullptr;		// freed by the audio manager
 	
-	gEntityManager.shutDown();
+	delete mpRewindBuffer;
+	mpRewindBuffer = nullptr;
+	delete mpHashLog;
+	mpHashLog = nullptr;
+	delete mpWorld;
+	mpWorld = nullptr;
+	gJobSystem.shutDown();
 	gAudioManager.shutDown();
 	gFontManager.shutDown();
 	gTextureManager.shutDown();
@@ -105,142 +103,145 @@ Application& Application::instance()
 
 bool Application::init()
 {
-	int lInitResult = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
-	if (lInitResult	< 0)
-	{
-		printf("SDL initialisation failed: %d\n", lInitResult);
-		return false;
-	}
-	
 	printf("Hello everyone!\n");
 	
-	const int kDisplayWidth = Settings::getInt("screen/width");
-	const int kDisplayHeight = Settings::getInt("screen/height");
-	if (!gVideo.init(kDisplayWidth, kDisplayHeight))
-		return false;
+	// Anything that doesn't need the window or GL can be done on another thread, while the main thread is busy with
+	// those.  Settings are read by almost everything, so they come first.
+	InitGraph lGraph;
+	lGraph.addTask("settings", InitGraph::kAnyThread, {}, []()
+	{
+		Settings::load();
+		return true;
+	});
+	lGraph.addTask("sdl", InitGraph::kMainThread, {}, []()
+	{
+		int lInitResult = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
+		if (lInitResult	< 0)
+		{
+			printf("SDL initialisation failed: %d\n", lInitResult);
+			return false;
+		}
+		return true;
+	});
+	lGraph.addTask("video", InitGraph::kMainThread, {"settings", "sdl"}, []()
+	{
+		if (!gVideo.init(Settings::getInt("screen/width"), Settings::getInt("screen/height")))
+			return false;
+		gTextureManager.init();
+		return true;
+	});
+	lGraph.addTask("fonts", InitGraph::kAnyThread, {"settings"}, []()
+	{
+		return gFontManager.init();
+	});
+	lGraph.addTask("audio", InitGraph::kAnyThread, {"sdl"}, []()
+	{
+		// Init audio if possible; we can cope without it if needed, though
+		gAudioManager.init();
+		return true;
+	});
+	lGraph.addTask("music", InitGraph::kAnyThread, {"settings", "audio"}, [this]()
+	{
+		mpMusic = gAudioManager.loadMusic("data/music/" + Settings::getString("sound/music"));
+		return true;
+	});
+	lGraph.addTask("image decoders", InitGraph::kAnyThread, {}, []()
+	{
+		TextureManager::initDecoding();
+		return true;
+	});
 	
-	gTextureManager.init();
+	// The texture manager spreads the images over the job system's threads
+	lGraph.addTask("images", InitGraph::kAnyThread, {"settings", "image decoders"}, []()
+	{
+		gTextureManager.decode(Settings::getStringVector("startup/preload_images"));
+		return true;
+	});
+	lGraph.addTask("simulation", InitGraph::kMainThread, {"images", "settings", "video"}, [this]()
+	{
+		return initSimulation(Settings::getFloat("screen/width"), Settings::getFloat("screen/height"));
+	});
 	
-	if (!gFontManager.init(gVideo.getDisplaySurface()))
+	bool lSucceeded = lGraph.run();
+	lGraph.printReport();
+	if (!lSucceeded)
 		return false;
 	
-	gEntityManager.init();
-	
-	Camera* lpCamera = new Camera(float(kDisplayWidth) * 0.5f, float(kDisplayHeight) * 0.5f,
-								  float(kDisplayWidth), float(kDisplayHeight));
-	ASSERT(lpCamera == gpCamera);
-	
-	// Init audio if possible; we can cope without it if needed, though
-	gAudioManager.init();
-	mpMusic = gAudioManager.loadMusic("data/music/" + Settings::getString("sound/music"));
-	if (page_isMusicEnabled())
+	if (Platform::pageIsMusicEnabled())
 		mpMusic->play();
 	
-	gDebug = page_isDebugEnabled();
-	
-	initBackground(kDisplayWidth, kDisplayHeight);
-	initObjects();
+	gDebug = Platform::pageIsDebugEnabled();
 	
-	//CarEntity* lpCar = new CarEntity(50.0f, 50.0f, "red");
-	//gEntityManager.registerEntity(lpCar);
-	gEntityManager.registerEntity(new PlayerCarEntity(300.0f, 300.0f));
+	mFrameScheduler.init(Settings::getFloat("screen/target_fps"), Settings::getFloat("screen/idle_fps"),
+						 Settings::getFloat("screen/fps_update_interval_sec"));
 	
 	// Set up the times immediately before starting the main loop
-	mStartTimeSec = emscripten_get_now() * 0.001f;
+	mStartTimeSec = Platform::getTimeMS() * 0.001f;
 	mCurrentTimeSec = mStartTimeSec;
 	
-	emscripten_set_main_loop(&Application::updateWrapper, 0, 0);
+	// On native builds this doesn't return until the app quits (and has deleted itself), so no members may be used
+	// after this call
+	Platform::runMainLoop(&Application::updateWrapper);
 	
 	return true;
 }
 
 //------------------------------------------------------------------------------
 
-void Application::initBackground(float lDisplayWidth, float lDisplayHeight)
+bool Application::initSimulation(float lDisplayWidth, float lDisplayHeight)
 {
-	Texture* lpTexture = gTextureManager.load("data/grass.jpg");
+	mStepSec = 1.0f / Settings::getFloat("simulation/step_rate");
+	mMaxCatchUpSteps = max(Settings::getInt("simulation/max_catch_up_steps"), 1);
+	mAccumulatorSec = 0.0f;
+	
+	mpWorld = new World(lDisplayWidth, lDisplayHeight);
+	mpWorld->entities().setUpdateInParallel(Settings::getInt("simulation/parallel_update") != 0);
+	InputManager& lrInput = mpWorld->input();
+	
+	// A replay brings its own seed, as it only plays out the same way with the same random numbers
+	uint32_t lSeed;
+	std::string lReplayFileName = getArgValue("--replay");
+	if (!lReplayFileName.empty())
+	{
+		if (!lrInput.startReplay(lReplayFileName))
+			return false;
+		if (lrInput.replayStepRate() != Settings::getInt("simulation/step_rate"))
+			printf("Warning: the replay was recorded at %d steps per second, so it won't play out the same\n",
+				   lrInput.replayStepRate());
+		lSeed = lrInput.replaySeed();
+	}
+	else
+		lSeed = RandomManager::chooseSeed(getArgValue("--seed"));
+	mpWorld->random().seed(lSeed);
 	
-	float lCentreX = lDisplayWidth * 0.5f;
-	float lCentreY = lDisplayHeight * 0.5f;
+	std::string lRecordFileName = getArgValue("--record");
+	if (!lRecordFileName.empty())
+		lrInput.startRecording(lRecordFileName, lSeed, Settings::getInt("simulation/step_rate"));
 	
-	for (int lXTile = -1; lXTile <= 1; ++lXTile)
-		for (int lYTile = -1; lYTile <= 1; ++lYTile)
-		{
-			float lX = lCentreX + lXTile * lDisplayWidth;
-			float lY = lCentreY + lYTile * lDisplayHeight;
-			SpriteEntity* lpBackground = new SpriteEntity(lX, lY);
-			lpBackground->setName((std::ostringstream() << "background (" << lXTile << ", " << lYTile << ")").str());
-			lpBackground->setTexture(lpTexture);
-			lpBackground->setBlendEnabled(false);
-			gEntityManager.registerEntity(lpBackground);	// must be first
-		}
+	mpWorld->init();
 	
-	mAreaLeft = -lDisplayWidth;
-	mAreaTop = -lDisplayHeight;
-	mAreaRight = 2.0f * lDisplayWidth;
-	mAreaBottom = 2.0f * lDisplayHeight;
-}
-
-//------------------------------------------------------------------------------
-
-void Application::initObjects()
-{
-	Settings::setGroup("level");
-	std::vector<std::string> lHouseNames = Settings::getStringVector("houses");
-	for (const std::string& lrName: lHouseNames)
+	std::string lHashLogFileName = getArgValue("--hash-log");
+	if (!lHashLogFileName.empty())
 	{
-		std::string lPosKey = "house" + lrName + "_pos";
-		std::vector<float> lHousePos = Settings::getFloatVector(lPosKey);
-		float lHouseX = getFloatParam(lHousePos, 0) - 800;	//
-		float lHouseY = getFloatParam(lHousePos, 1) - 600;	// for typing convenience :)
-		HouseEntity* lpNewHouse = new HouseEntity(lHouseX, lHouseY);
-		
-		std::string lTexKey = "house" + lrName + "_tex";
-		std::string lTex = Settings::getString(lTexKey);
-		if (lTex.empty())
-			lTex = (std::ostringstream() << (1 + int(emscripten_random() * 9.0f))).str();
-		lpNewHouse->setTexture(gTextureManager.load("data/tex/house-" + lTex + ".jpg"));
-		
-		gEntityManager.registerEntity(lpNewHouse);
-		lpNewHouse->setName("house_" + lrName);
+		mpHashLog = new HashLog;
+		if (!mpHashLog->open(lHashLogFileName))
+			return false;
+		mpHashLog->add(mpWorld->numSteps(), mpWorld->stateHash());
 	}
 	
-	std::vector<std::string> lMenNames = Settings::getStringVector("men");
-	for (const std::string& lrName: lMenNames)
+	// There's no keyboard or speaker without a window
+	lrInput.setLiveInputEnabled(!mHeadless);
+	mpWorld->setSoundEnabled(!mHeadless);
+	
+	if (!mHeadless)
 	{
-		std::string lPosKey = "man" + lrName + "_pos";
-		std::vector<float> lHousePos = Settings::getFloatVector(lPosKey);
-		float lManX = getFloatParam(lHousePos, 0) - 800;	//
-		float lManY = getFloatParam(lHousePos, 1) - 600;	// for typing convenience :)
-		ManEntity* lpNewMan = new ManEntity(lManX, lManY);
-		
-		gEntityManager.registerEntity(lpNewMan);
+		int lRewindSteps = int(Settings::getFloat("rewind/duration_sec") / mStepSec);
+		mpRewindBuffer = new RewindBuffer(lRewindSteps, Settings::getInt("rewind/keyframe_interval"));
+		mpWorld->saveSnapshot(&mRetrySnapshot);
+		mRetrySnapshotStep = mpWorld->numSteps();
 	}
 	
-	mpArrow = new SpriteEntity(0.0f, 0.0f);
-	mpArrow->setTexture(gTextureManager.load("data/tex/arrow.png"));
-	mpArrow->setVisible(false);
-	mpArrow->setBehindCamera(true);
-	gEntityManager.registerEntity(mpArrow);
-}
-
-//------------------------------------------------------------------------------
-
-void Application::addCash(int lAmount)
-{
-	mCash += lAmount;
-}
-
-//------------------------------------------------------------------------------
-
-void Application::setStatusMessage(const std::string &lrText, const std::string& lrText2)
-{
-	static const float kDisplayTimeSec = Settings::getFloat("general/msg_display_time_sec");
-	mStatusMsg  = lrText2.empty() ? std::string() : lrText;
-	mStatusMsg2 = lrText2.empty() ? lrText : lrText2;
-	mMsgDisplayTimeSec = kDisplayTimeSec;
-	if (!lrText2.empty())
-		mMsgDisplayTimeSec *= 1.5f;
+	return true;
 }
 
 //------------------------------------------------------------------------------
@@ -261,6 +262,8 @@ void Application::processEvents()
 					quit();
 				else if (lEvent.key.keysym.sym == SDLK_m)
 					toggleMusic(UpdatePage);
+				else if (lEvent.key.keysym.sym == SDLK_r)
+					retry();
 				else if (lEvent.key.keysym.sym == SDLK_RETURN)
 				{
 					if (!sReturnHeld)
@@ -283,39 +286,85 @@ void Application::processEvents()
 
 void Application::update(float lTimeDeltaSec)
 {
-	gEntityManager.update(lTimeDeltaSec);
+	mpWorld->updateArrow();
+	updateIdleTime(lTimeDeltaSec);
 	
-	gpCamera->updateFromPlayer(gpPlayer, mAreaLeft, mAreaTop, mAreaRight, mAreaBottom);
-	
-	if (mMsgDisplayTimeSec > 0.0f)
+	gVideo.update(lTimeDeltaSec);
+}
+
+//------------------------------------------------------------------------------
+
+void Application::stepSimulation()
+{
+	// Holding backspace runs time backwards a step at a time, as far as the rewind buffer goes
+	if (Platform::isKeyHeld(SDLK_BACKSPACE))
 	{
-		mMsgDisplayTimeSec -= lTimeDeltaSec;
-		if (mMsgDisplayTimeSec <= 0.0f)
+		if (mpRewindBuffer->pop(&mSnapshot))
 		{
-			mStatusMsg.clear();
-			mStatusMsg2.clear();
+			bool lLoaded = mpWorld->loadSnapshot(mSnapshot);
+			ASSERT(lLoaded);
 		}
+		return;
 	}
 	
-	if (mCountdownSec > 0.0f)
-	{
-		mCountdownSec -= lTimeDeltaSec;
-		if (mCountdownSec <= 0.0f)
-			losePassenger();
-	}
+	mpWorld->saveSnapshot(&mSnapshot);
+	mpRewindBuffer->push(mSnapshot);
 	
-	updateArrow();
+	// The rewind buffer has a snapshot for each step back to its oldest
+	uint32_t lNumSteps = mpWorld->numSteps();
+	uint32_t lNumSnapshots = uint32_t(mpRewindBuffer->numSnapshots());
+	uint32_t lOldestRewindStep = lNumSnapshots > lNumSteps ? 0 : lNumSteps - lNumSnapshots + 1;
+	mpWorld->setOldestSnapshotStep(min(mRetrySnapshotStep, lOldestRewindStep));
 	
-	gVideo.update(lTimeDeltaSec);
+	bool lHadPassenger = mpWorld->havePassenger();
+	mpWorld->step(mStepSec);
+	if (mpWorld->havePassenger() && !lHadPassenger)
+	{
+		mpWorld->saveSnapshot(&mRetrySnapshot);
+		mRetrySnapshotStep = mpWorld->numSteps();
+	}
+	if (mpHashLog != nullptr)
+		mpHashLog->add(mpWorld->numSteps(), mpWorld->stateHash());
 }
 
 //------------------------------------------------------------------------------
 
-void Application::render() const
+void Application::retry()
+{
+	bool lLoaded = mpWorld->loadSnapshot(mRetrySnapshot);
+	ASSERT(lLoaded);
+	mpRewindBuffer->clear();
+}
+
+//------------------------------------------------------------------------------
+
+void Application::updateIdleTime(float lTimeDeltaSec)
+{
+	const PlayerCarEntity& lrPlayer = mpWorld->player();
+	bool lActive = mpWorld->havePassenger() || mpWorld->isShowingMessage() || lrPlayer.hasControlInput()
+				   || !floatApproxEquals(lrPlayer.speed(), 0.0f);
+	if (lActive)
+		mIdleTimeSec = 0.0f;
+	else
+		mIdleTimeSec += lTimeDeltaSec;
+}
+
+//------------------------------------------------------------------------------
+
+bool Application::isIdle() const
+{
+	static const float kIdleDelaySec = Settings::getFloat("screen/idle_delay_sec");
+	return mIdleTimeSec >= kIdleDelaySec || !Platform::isWindowVisible();
+}
+
+//------------------------------------------------------------------------------
+
+void Application::render(float lInterpFactor) const
 {
 	gVideo.clear();
 	
-	gEntityManager.render();
+	Entity::setRenderInterpolation(lInterpFactor);
+	mpWorld->entities().render();
 	
 	//gFontManager.renderInWorld("This moves", 50.0f, 50.0f, { 0xFF, 0x80, 0, 0xFF });
 	//gFontManager.renderOnScreen("This doesn't", 200.0f, 200.0f, { 0xFF, 0, 0, 0xFF }, FontManager::kAlignLeft);
@@ -325,17 +374,20 @@ void Application::render() const
 	static const SDL_Colour kYellow = { 0xFF, 0xFF, 0, 0xFF };
 	static const SDL_Colour kRed = { 0xFF, 0x40, 0x40, 0xFF };
 	
-	char lTextBuf[16];
+	char lTextBuf[32];
 	
 	if (gDebug)
 	{
-		snprintf(lTextBuf, sizeof(lTextBuf), "FPS: %.1f", gVideo.approxFPS());
+		snprintf(lTextBuf, sizeof(lTextBuf), "FPS: %.1f%s", gVideo.approxFPS(), mFrameScheduler.isIdle() ? " (idle)" : "");
 		gFontManager.renderOnScreen(lTextBuf, -10.0f, -30.0f, kWhite, FontManager::kAlignRight, FontManager::kAlignBottom);
+		snprintf(lTextBuf, sizeof(lTextBuf), "CPU: %.2f ms (%.0f%%)", mFrameScheduler.cpuMSPerFrame(),
+				 mFrameScheduler.cpuFraction() * 100.0f);
+		gFontManager.renderOnScreen(lTextBuf, -10.0f, -52.0f, kWhite, FontManager::kAlignRight, FontManager::kAlignBottom);
 	}
 	
-	if (mCountdownSec > 0.0f)
+	if (mpWorld->havePassenger())
 	{
-		snprintf(lTextBuf, sizeof(lTextBuf), "%.1f", mCountdownSec);
+		snprintf(lTextBuf, sizeof(lTextBuf), "%.1f", mpWorld->countdownSec());
 		gFontManager.renderOnScreen(lTextBuf, -10.0f, -8.0f, kRed, FontManager::kAlignRight, FontManager::kAlignBottom);
 	}
 	
@@ -344,17 +396,19 @@ void Application::render() const
 	//snprintf(lTextBuf, sizeof(lTextBuf), "Dir: %.1f", gpPlayer->rotationRad());
 	//gFontManager.renderOnScreen(lTextBuf, 140.0f, -10.0f, kOrange, FontManager::kAlignLeft, FontManager::kAlignBottom);
 	
-	snprintf(lTextBuf, sizeof(lTextBuf), "$%d", mCash);	// TO DO: pounds or euros :)
+	snprintf(lTextBuf, sizeof(lTextBuf), "$%d", mpWorld->cash());	// TO DO: pounds or euros :)
 	gFontManager.renderOnScreen(lTextBuf, 10.0f, -8.0f, kOrange, FontManager::kAlignLeft, FontManager::kAlignBottom);
 	
 	static const float kScreenWidth = Settings::getFloat("screen/width");
 	//static const float kScreenHeight = Settings::getFloat("screen/height");
 	
-	if (!mStatusMsg.empty())
-		gFontManager.renderOnScreen(mStatusMsg.c_str(), kScreenWidth * 0.5f, -30.0f, kYellow, FontManager::kAlignXCentre,
+	const std::string& lrStatusMsg = mpWorld->statusMessage();
+	const std::string& lrStatusMsg2 = mpWorld->statusMessage2();
+	if (!lrStatusMsg.empty())
+		gFontManager.renderOnScreen(lrStatusMsg.c_str(), kScreenWidth * 0.5f, -30.0f, kYellow, FontManager::kAlignXCentre,
 									FontManager::kAlignBottom);
-	if (!mStatusMsg2.empty())
-		gFontManager.renderOnScreen(mStatusMsg2.c_str(), kScreenWidth * 0.5f, -8.0f, kYellow, FontManager::kAlignXCentre,
+	if (!lrStatusMsg2.empty())
+		gFontManager.renderOnScreen(lrStatusMsg2.c_str(), kScreenWidth * 0.5f, -8.0f, kYellow, FontManager::kAlignXCentre,
 									FontManager::kAlignBottom);
 	
 	gVideo.flip();
@@ -362,140 +416,342 @@ void Application::render() const
 
 //------------------------------------------------------------------------------
 
-HouseEntity* Application::findHouse(const std::string &lrLabel) const
+void Application::update()
 {
-	for (Entity* lpEntity: gEntityManager.allEntities())
+	// Process any pending quit request
+	if (mQuit)
 	{
-		HouseEntity* lpHouse = dynamic_cast<HouseEntity*> (lpEntity);
-		if (lpHouse == nullptr)
-			continue;
-		if (lpHouse->name() == "house_" + lrLabel)
-			return lpHouse;
+		delete this;
+		return;
 	}
-	return nullptr;
-}
-
-//------------------------------------------------------------------------------
-
-HouseEntity* Application::pickRandomHouse()
-{
-	static const std::vector<std::string> kDestinations = Settings::getStringVector("level/destinations");
 	
-	HouseEntity* lpHouse = nullptr;
-	do
+	mFrameScheduler.beginFrame();
+	
+	float lPrevTimeSec = mCurrentTimeSec;
+	mCurrentTimeSec = Platform::getTimeMS() * 0.001f;
+	float lTimeDeltaSec = mCurrentTimeSec - lPrevTimeSec;
+	
+	processEvents();
+	
+	// Advance the simulation in fixed steps.  After a long frame, only catch up a limited amount, so a stall doesn't
+	// turn into a burst of steps that makes the next frame long as well.
+	mAccumulatorSec += lTimeDeltaSec;
+	int lNumSteps = 0;
+	while (mAccumulatorSec >= mStepSec && lNumSteps < mMaxCatchUpSteps)
+	{
+		stepSimulation();
+		mAccumulatorSec -= mStepSec;
+		++lNumSteps;
+	}
+	if (mAccumulatorSec >= mStepSec)
+		mAccumulatorSec = fmodf(mAccumulatorSec, mStepSec);
+	
+	update(lTimeDeltaSec);
+	render(mAccumulatorSec / mStepSec);
+	
+	if (!mFirstFrameShown)
 	{
-		int lTargetIndex = emscripten_random() * float(kDestinations.size());
-		std::string lTargetName = kDestinations[lTargetIndex];
-		lpHouse = findHouse(lTargetName);
-	} while (lpHouse == mpCurrentHouse);
-	
-	ASSERT(lpHouse != nullptr);
-	mpCurrentHouse = lpHouse;
-	return lpHouse;
+		printf("First frame shown %.1f ms after start-up\n", Platform::getTimeMS());
+		mFirstFrameShown = true;
+	}
+	
+	mFrameScheduler.endFrame(isIdle());
 }
 
 //------------------------------------------------------------------------------
 
-void Application::losePassenger()
+void Application::updateWrapper()
 {
-	ASSERT(mpCurrentHouse != nullptr);
-	setStatusMessage(mpCurrentHouse->getLoseMessage());
-	ASSERT(mpCurrentTarget != nullptr);
-	mpCurrentTarget->kill();
-	mpCurrentTarget = nullptr;
-	stopCountdown();
-	playSound("lose", 3);
+	if (msInstance != nullptr)		// this can be null in rare cases, such as after exit when the page is reloaded
+		msInstance->update();
 }
 
 //------------------------------------------------------------------------------
 
-void Application::winPassenger(int lCashValue)
+int Application::run()
 {
-	ASSERT(mpCurrentHouse != nullptr);
-	
-	std::string lMsg = mpCurrentHouse->getWinMessage();
-	char lBuf[256];
-	snprintf(lBuf, sizeof(lBuf), lMsg.c_str(), lCashValue);
-	setStatusMessage(lBuf);
-	addCash(lCashValue);
-	stopCountdown();
-	setCurrentTarget(nullptr);	// killed already
-	playSound("win", 3);
+	// Compares two logs from "--hash-log", e.g. from two builds running the same replay
+	if (hasArg("--compare-hashes"))
+	{
+		size_t lIndex = std::find(mArgs.begin(), mArgs.end(), "--compare-hashes") - mArgs.begin();
+		int lResult = 2;
+		if (lIndex + 2 < mArgs.size())
+			lResult = HashLog::compare(mArgs[lIndex + 1], mArgs[lIndex + 2]);
+		else
+			printf("Usage: --compare-hashes <log file 1> <log file 2>\n");
+		delete this;
+		return lResult;
+	}
+	
+	// Shared by everything, in every mode
+	gJobSystem.init(Platform::numWorkerThreads());
+	
+	if (hasArg("--headless"))
+	{
+		// An optional duration can follow the flag
+		std::string lDuration = getArgValue("--headless");
+		float lDurationSec = lDuration.empty() ? 0.0f : float(atof(lDuration.c_str()));
+		
+		int lResult = runHeadless(lDurationSec);
+		delete this;
+		return lResult;
+	}
+	
+	if (!init())
+		return 1;
+	
+	return 0;
 }
 
 //------------------------------------------------------------------------------
 
-void Application::updateArrow()
+int Application::runHeadless(float lDurationSec)
 {
-	bool lShowArrow = mpCurrentTarget != nullptr && !gpCamera->canSee(mpCurrentTarget);
-	mpArrow->setVisible(lShowArrow);
-	if (!lShowArrow)
-		return;
+	mHeadless = true;
+	
+	// Textures are still loaded, since the simulation uses their sizes, but nothing else is initialised
+	gTextureManager.init(TextureManager::DoNotUseGL);
+	const float kViewWidth = Settings::getFloat("screen/width");
+	const float kViewHeight = Settings::getFloat("screen/height");
+	if (!initSimulation(kViewWidth, kViewHeight))
+		return 1;
+	
+	// Without a duration, a replay runs to its end
+	int lNumSteps;
+	if (lDurationSec > 0.0f)
+		lNumSteps = int(ceilf(lDurationSec / mStepSec));
+	else if (mpWorld->input().isReplaying())
+		lNumSteps = int(mpWorld->input().replayNumSteps());
+	else
+		lNumSteps = int(ceilf(Settings::getFloat("headless/duration_sec") / mStepSec));
+	const int kNumSteps = lNumSteps;
 	
-	float lOffsetX = mpCurrentTarget->x() - gpCamera->x();
-	float lOffsetY = mpCurrentTarget->y() - gpCamera->y();
-	// Push the largest offset to the edge, and then the other one will be an appropriate fraction of it
-	float lFactor = 1.0f / max(fabsf(lOffsetX), fabsf(lOffsetY));
-	float lOffsetXFactor = lOffsetX * lFactor;
-	float lOffsetYFactor = lOffsetY * lFactor;
-	
-	float lRotationRad, lUnused;
-	getPolarFromRect(lOffsetX, lOffsetY, &lUnused, &lRotationRad);
-	
-	static const float kHalfDisplayWidth = Settings::getFloat("screen/width") * 0.5f;
-	static const float kHalfDisplayHeight = Settings::getFloat("screen/height") * 0.5f;
-	float lOffsetWidth = kHalfDisplayWidth - mpArrow->halfWidth();
-	float lOffsetHeight = kHalfDisplayHeight - mpArrow->halfHeight();
-	mpArrow->setPos(kHalfDisplayWidth  + lOffsetXFactor * lOffsetWidth,
-					kHalfDisplayHeight + lOffsetYFactor * lOffsetHeight);
-	mpArrow->setRotationRad(lRotationRad);
+	if (hasArg("--desync-check"))
+		return runDesyncCheck(kNumSteps);
+	if (hasArg("--handling-bench"))
+	{
+		std::string lNumCars = getArgValue("--handling-bench");
+		return runHandlingBenchmark(lNumCars.empty() || lNumCars[0] == '-' ? 10000 : max(atoi(lNumCars.c_str()), 1));
+	}
+	
+	// Any extra worlds follow the first one's seed, and have no input
+	std::string lNumWorldsArg = getArgValue("--worlds");
+	std::string lNumThreadsArg = getArgValue("--threads");
+	const int kNumWorlds = max(lNumWorldsArg.empty() ? 1 : atoi(lNumWorldsArg.c_str()), 1);
+	const int kNumThreads = lNumThreadsArg.empty() ? gJobSystem.numThreads() :
+							min(max(atoi(lNumThreadsArg.c_str()), 1), gJobSystem.numThreads());
+	
+	std::vector<World*> lWorlds(1, mpWorld);
+	if (kNumWorlds > 1)
+		mpWorld->entities().setUpdateInParallel(false);		// the worlds have the threads between them instead
+	for (int lWorldIndex = 1; lWorldIndex < kNumWorlds; ++lWorldIndex)
+	{
+		World* lpWorld = new World(kViewWidth, kViewHeight);
+		lpWorld->entities().setLoggingEnabled(false);
+		lpWorld->random().seed(mpWorld->random().currentSeed() + uint32_t(lWorldIndex));
+		lpWorld->init();
+		lWorlds.push_back(lpWorld);
+	}
+	
+	printf("Running headless for %.1f simulated seconds", float(kNumSteps) * mStepSec);
+	if (kNumWorlds > 1)
+		printf(" in %d worlds on %d threads", kNumWorlds, min(kNumThreads, kNumWorlds));
+	printf("\n");
+	
+	// Logging needs the hash after every step, so then the first world goes a step at a time on its own
+	std::vector<World*> lWorldsInParallel(lWorlds.begin() + (mpHashLog != nullptr ? 1 : 0), lWorlds.end());
+	double lStartTimeMS = Platform::getTimeMS();
+	if (mpHashLog != nullptr)
+		for (int lStep = 0; lStep < kNumSteps; ++lStep)
+		{
+			mpWorld->step(mStepSec);
+			mpHashLog->add(mpWorld->numSteps(), mpWorld->stateHash());
+		}
+	World::stepInParallel(lWorldsInParallel, kNumSteps, mStepSec, kNumThreads);
+	double lWallTimeSec = (Platform::getTimeMS() - lStartTimeMS) * 0.001;
+	
+	float lSimulatedSec = float(kNumSteps) * mStepSec;
+	double lTotalSteps = double(kNumSteps) * kNumWorlds;
+	printf("Simulated %.1f s (%d steps) in %.3f s: %.1f simulated seconds per wall second, %.0f steps per second\n",
+		   lSimulatedSec, kNumSteps, lWallTimeSec, lSimulatedSec * kNumWorlds / max(lWallTimeSec, 1.0e-9),
+		   lTotalSteps / max(lWallTimeSec, 1.0e-9));
+	for (int lWorldIndex = 0; lWorldIndex < kNumWorlds && kNumWorlds > 1; ++lWorldIndex)
+		printf("    world %d (seed %u): $%d\n", lWorldIndex, lWorlds[lWorldIndex]->random().currentSeed(),
+			   lWorlds[lWorldIndex]->cash());
+	
+	for (int lWorldIndex = 1; lWorldIndex < kNumWorlds; ++lWorldIndex)
+		delete lWorlds[lWorldIndex];
+	
+	// Keep an eye on the cost of snapshots, as the rewind buffer takes one every step
+	const int kNumSnapshotRuns = 1000;
+	std::vector<uint8_t> lSnapshot;
+	double lSaveStartMS = Platform::getTimeMS();
+	for (int lRun = 0; lRun < kNumSnapshotRuns; ++lRun)
+		mpWorld->saveSnapshot(&lSnapshot);
+	double lLoadStartMS = Platform::getTimeMS();
+	for (int lRun = 0; lRun < kNumSnapshotRuns; ++lRun)
+		mpWorld->loadSnapshot(lSnapshot);
+	double lLoadEndMS = Platform::getTimeMS();
+	printf("Snapshot: %u bytes, %.1f us to save, %.1f us to load\n", unsigned(lSnapshot.size()),
+		   (lLoadStartMS - lSaveStartMS) * 1000.0 / kNumSnapshotRuns, (lLoadEndMS - lLoadStartMS) * 1000.0 / kNumSnapshotRuns);
+	return 0;
 }
 
 //------------------------------------------------------------------------------
 
-void Application::playSound(const std::string &lrName, int lMaxNum)
+int Application::runDesyncCheck(int lNumSteps)
 {
-	int lIndex = 1 + emscripten_random() * float(lMaxNum);
-	std::string lFileName = (std::ostringstream() << "data/sfx/" << lrName << lIndex << ".ogg").str();
-	gAudioManager.loadSound(lFileName)->play();
+	// The copy is set up just like the first world, with the same replay (if any) and seed.  It updates its entities
+	// on one thread, so this also checks that the first world's parallel update (if enabled) gives the same results.
+	World lCopy(Settings::getFloat("screen/width"), Settings::getFloat("screen/height"));
+	lCopy.entities().setLoggingEnabled(false);
+	std::string lReplayFileName = getArgValue("--replay");
+	if (!lReplayFileName.empty() && !lCopy.input().startReplay(lReplayFileName))
+		return 1;
+	lCopy.random().seed(mpWorld->random().currentSeed());
+	lCopy.init();
+	
+	printf("Checking for desyncs over %d steps\n", lNumSteps);
+	double lStartTimeMS = Platform::getTimeMS();
+	for (int lStep = 0; lStep <= lNumSteps; ++lStep)
+	{
+		if (lStep > 0)
+		{
+			mpWorld->step(mStepSec);
+			lCopy.step(mStepSec);
+		}
+		if (mpWorld->stateHash() == lCopy.stateHash())
+			continue;
+		
+		printf("Desync at step %u\n", mpWorld->numSteps());
+		const std::vector<Entity*>& lrEntities = mpWorld->entities().allEntities();
+		const std::vector<Entity*>& lrCopyEntities = lCopy.entities().allEntities();
+		if (lrEntities.size() != lrCopyEntities.size())
+			printf("    %u entities, but %u in the copy\n", unsigned(lrEntities.size()), unsigned(lrCopyEntities.size()));
+		for (size_t lIndex = 0; lIndex < min(lrEntities.size(), lrCopyEntities.size()); ++lIndex)
+		{
+			StateHash lHash, lCopyHash;
+			lrEntities[lIndex]->addToHash(lHash);
+			lrCopyEntities[lIndex]->addToHash(lCopyHash);
+			if (lrEntities[lIndex]->id() != lrCopyEntities[lIndex]->id() || lHash.value() != lCopyHash.value())
+			{
+				printf("    first different entity: %s %d at (%f, %f), but %s %d at (%f, %f) in the copy\n",
+					   lrEntities[lIndex]->type(), lrEntities[lIndex]->id(), lrEntities[lIndex]->x(), lrEntities[lIndex]->y(),
+					   lrCopyEntities[lIndex]->type(), lrCopyEntities[lIndex]->id(), lrCopyEntities[lIndex]->x(),
+					   lrCopyEntities[lIndex]->y());
+				break;
+			}
+		}
+		printf("    cash $%d, countdown %f, but $%d, %f in the copy\n", mpWorld->cash(), mpWorld->countdownSec(),
+			   lCopy.cash(), lCopy.countdownSec());
+		return 1;
+	}
+	
+	// Hashing is done every step, so keep an eye on its cost next to the steps themselves
+	double lWallTimeMS = Platform::getTimeMS() - lStartTimeMS;
+	const int kNumHashRuns = 1000;
+	volatile uint64_t lHash = 0;
+	double lHashStartMS = Platform::getTimeMS();
+	for (int lRun = 0; lRun < kNumHashRuns; ++lRun)
+		lHash = mpWorld->stateHash();
+	double lHashEndMS = Platform::getTimeMS();
+	printf("No desync in %d steps (final hash %016" PRIx64 "): %.2f us per step for each world, %.2f us per hash\n",
+		   lNumSteps, uint64_t(lHash), lWallTimeMS * 1000.0 / (2.0 * max(lNumSteps, 1)),
+		   (lHashEndMS - lHashStartMS) * 1000.0 / kNumHashRuns);
+	return 0;
 }
 
 //------------------------------------------------------------------------------
 
-void Application::update()
+int Application::runHandlingBenchmark(int lNumCars)
 {
-	// Process any pending quit request
-	if (mQuit)
+	// Cars in every state the handling has: stopped (some waiting to switch direction), slow, fast, sliding, steering,
+	// accelerating, braking and coasting, forwards and in reverse
+	const CarHandling& lrHandling = mpWorld->handling();
+	RandomStream lRandom;
+	lRandom.seed(1, 0);
+	std::vector<CarHandlingState> lCars(lNumCars);
+	for (CarHandlingState& lrCar: lCars)
 	{
-		delete this;
-		return;
+		float lSpeed = lRandom.getInt(8) == 0 ? 0.0f : lRandom.getFloat() * lrHandling.mHighThreshold * 1.5f;
+		float lVelAngleRad = lRandom.getFloat() * float(2.0 * M_PI);
+		lrCar.mVelX = cosf(lVelAngleRad) * lSpeed;
+		lrCar.mVelY = sinf(lVelAngleRad) * lSpeed;
+		lrCar.mRotationRad = (lRandom.getFloat() - 0.5f) * 40.0f;
+		getRectFromPolar(1.0f, lrCar.mRotationRad, &lrCar.mFacingX, &lrCar.mFacingY);
+		lrCar.mSteerCtrl = float(lRandom.getInt(3) - 1);
+		lrCar.mAccelCtrl = float(lRandom.getInt(3) - 1);
+		lrCar.mSwitchDirTimeSec = lRandom.getFloat() * lrHandling.mAutoreverseHoldTimeSec;
+		lrCar.mReversing = lRandom.getInt(2) == 0;
 	}
 	
-	float lPrevTimeSec = mCurrentTimeSec;
-	mCurrentTimeSec = emscripten_get_now() * 0.001f;
-	float lTimeDeltaSec = mCurrentTimeSec - lPrevTimeSec;
-	
-	processEvents();
-	update(lTimeDeltaSec);
-	render();
+	CarHandlingBatch lBatch;
+	lBatch.resize(lCars.size());
+	for (size_t lIndex = 0; lIndex < lCars.size(); ++lIndex)
+		lBatch.set(lIndex, lCars[lIndex]);
+	
+	// A second of steps from the same start.  The batch does the same sums in the same order as the reference, so they
+	// should agree exactly.
+	const int kNumCheckSteps = int(1.0f / mStepSec + 0.5f);
+	std::vector<CarHandlingState> lReferenceCars = lCars;
+	int lNumMismatches = 0;
+	for (int lStep = 0; lStep < kNumCheckSteps; ++lStep)
+	{
+		updateCarHandlingBatch(lrHandling, mStepSec, &lBatch);
+		for (size_t lIndex = 0; lIndex < lReferenceCars.size(); ++lIndex)
+		{
+			CarHandlingState& lrReference = lReferenceCars[lIndex];
+			bool lMoving = updateCarHandling(lrHandling, mStepSec, &lrReference);
+			CarHandlingState lBatchCar = lBatch.get(lIndex);
+			if (lBatchCar.mVelX != lrReference.mVelX || lBatchCar.mVelY != lrReference.mVelY ||
+				lBatchCar.mFacingX != lrReference.mFacingX || lBatchCar.mFacingY != lrReference.mFacingY ||
+				lBatchCar.mRotationRad != lrReference.mRotationRad ||
+				lBatchCar.mSwitchDirTimeSec != lrReference.mSwitchDirTimeSec ||
+				lBatchCar.mReversing != lrReference.mReversing || lBatch.wasMoving(lIndex) != lMoving)
+				++lNumMismatches;
+		}
+	}
+	bool lPassed = lNumMismatches == 0;
+	printf("Car handling for %d cars over %d steps, %d at a time: %d car updates differed from the reference: %s\n",
+		   lNumCars, kNumCheckSteps, carHandlingBatchWidth(), lNumMismatches, lPassed ? "pass" : "FAIL");
+	
+	// Then the speed of each, for long enough to be measurable
+	const int kNumTimedSteps = max(1000000 / lNumCars, 10);
+	double lReferenceStartMS = Platform::getTimeMS();
+	for (int lStep = 0; lStep < kNumTimedSteps; ++lStep)
+		for (CarHandlingState& lrCar: lCars)
+			updateCarHandling(lrHandling, mStepSec, &lrCar);
+	double lBatchStartMS = Platform::getTimeMS();
+	for (int lStep = 0; lStep < kNumTimedSteps; ++lStep)
+		updateCarHandlingBatch(lrHandling, mStepSec, &lBatch);
+	double lBatchEndMS = Platform::getTimeMS();
+	
+	double lNumCarUpdates = double(lNumCars) * kNumTimedSteps;
+	double lReferenceCarsPerMS = lNumCarUpdates / max(lBatchStartMS - lReferenceStartMS, 1.0e-6);
+	double lBatchCarsPerMS = lNumCarUpdates / max(lBatchEndMS - lBatchStartMS, 1.0e-6);
+	printf("Cars updated per ms: %.0f one at a time, %.0f batched (%.1f times as many)\n", lReferenceCarsPerMS,
+		   lBatchCarsPerMS, lBatchCarsPerMS / lReferenceCarsPerMS);
+	return lPassed ? 0 : 1;
 }
 
 //------------------------------------------------------------------------------
 
-void Application::updateWrapper()
+bool Application::hasArg(const std::string& lrName) const
 {
-	if (msInstance != nullptr)		// this can be null in rare cases, such as after exit when the page is reloaded
-		msInstance->update();
+	for (const std::string& lrArg: mArgs)
+		if (lrArg == lrName)
+			return true;
+	return false;
 }
 
 //------------------------------------------------------------------------------
 
-int Application::run()
+std::string Application::getArgValue(const std::string& lrName) const
 {
-	if (!init())
-		return 1;
-	
-	return 0;
+	for (size_t lIndex = 1; lIndex + 1 < mArgs.size(); ++lIndex)
+		if (mArgs[lIndex] == lrName)
+			return mArgs[lIndex + 1];
+	return std::string();
 }
 
 //------------------------------------------------------------------------------
@@ -515,7 +771,7 @@ void Application::toggleMusic(PageUpdateType lUpdate)
 		mpMusic->play();
 	
 	if (lUpdate == UpdatePage)
-		page_toggleMusic();
+		Platform::pageToggleMusic();
 }
 
 //------------------------------------------------------------------------------
@@ -524,7 +780,7 @@ void Application::toggleDebug(PageUpdateType lUpdate)
 {
 	gDebug = !gDebug;
 	if (lUpdate == UpdatePage)
-		page_toggleDebug();
+		Platform::pageToggleDebug();
 }
 
 //------------------------------------------------------------------------------
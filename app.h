@@ -9,17 +9,19 @@
 #ifndef APP_H
 #define APP_H
 
+#include "framescheduler.h"
+
+#include <cstdint>
 #include <string>
 #include <vector>
 
 //------------------------------------------------------------------------------
 
+class HashLog;
 class Music;
-class HouseEntity;
+class RewindBuffer;
 class Sound;
-class SpriteEntity;
-class TargetEntity;
-class Texture;
+class World;
 
 //------------------------------------------------------------------------------
 
@@ -32,6 +34,8 @@ public:
 	static Application& instance();
 	
 	int run();		// returns a result code: 0 for success, or positive for error codes
+	
+	bool isHeadless() const { return mHeadless; }
 	void quit();	// sets a quit flag to be processed on the next update
 	
 	float getCurrentTimeMS() const;
@@ -40,64 +44,62 @@ public:
 	void toggleMusic(PageUpdateType lUpdate);
 	void toggleDebug(PageUpdateType lUpdate);
 	
-	float areaLeft() const { return mAreaLeft; }
-	float areaRight() const { return mAreaRight; }
-	float areaTop() const { return mAreaTop; }
-	float areaBottom() const { return mAreaBottom; }
-	
-	void addCash(int lAmount);
-	
-	void setStatusMessage(const std::string& lrText, const std::string& lrText2 = std::string());
-	
-	HouseEntity* findHouse(const std::string& lrLabel) const;
-	HouseEntity* pickRandomHouse();
-	
-	bool havePassenger() const { return mCountdownSec > 0.0f; }
-	void startCountdown() { mCountdownSec = 10.0f; }
-	void stopCountdown() { mCountdownSec = 0.0f; }
-	void losePassenger();
-	void winPassenger(int lCashValue);
-	void setCurrentTarget(TargetEntity* lpTarget) { mpCurrentTarget = lpTarget; }
-	
-	void playSound(const std::string& lrName, int lMaxNum);
-	
 private:
 	
 	void processEvents();
 	static void updateWrapper();		// just calls msInstance->update()
-	void update();						// calls non-static update(float) with time delta
-	void update(float lTimeDeltaSec);
-	void render() const;
+	void update();						// runs fixed simulation steps for the elapsed time, then update(float) and render()
+	void update(float lTimeDeltaSec);	// per-frame presentation updates
+	void stepSimulation();				// one fixed step forwards, or backwards while rewinding
+	void retry();						// back to the start of the current fare
+	void render(float lInterpFactor) const;			// interpolates between the last two simulation steps
 	
 	bool init();		// returns false on failure
-	void initBackground(float lDisplayWidth, float lDisplayHeight);
-	void initObjects();
+	bool initSimulation(float lDisplayWidth, float lDisplayHeight);
+	
+	// Runs the simulation alone, with no video, audio or fonts, as fast as possible for the given simulated time.  With
+	// a duration of zero, it runs to the end of any replay, or otherwise for the time in the settings.  "--worlds N"
+	// runs N independent worlds (seeded one apart) spread over up to "--threads" of the job system's threads.
+	int runHeadless(float lDurationSec);
+	
+	// Runs a second copy of the world alongside the first, and reports the first step where their state hashes
+	// differ.  Returns 0 if they never do.
+	int runDesyncCheck(int lNumSteps);
+	
+	// Checks the batched (SIMD) car handling against the reference version, one car at a time, and times them both.
+	// Returns 0 if they agree exactly.
+	int runHandlingBenchmark(int lNumCars);
+	
+	bool hasArg(const std::string& lrName) const;
+	std::string getArgValue(const std::string& lrName) const;	// the argument following lrName, or empty
 	void runMainLoopIteration();
-	void updateArrow();
+	void updateIdleTime(float lTimeDeltaSec);
+	bool isIdle() const;		// whether the frame rate can drop: nothing is happening, or no one can see it
 	
 	
 	static Application* msInstance;
 	
 	const std::vector<std::string> mArgs;
+	bool mHeadless;
 	
 	float mStartTimeSec;
 	float mCurrentTimeSec;
+	float mStepSec;				// fixed simulation step length
+	int mMaxCatchUpSteps;		// maximum simulation steps per frame; any further time is dropped
+	float mAccumulatorSec;		// time not yet simulated
+	FrameScheduler mFrameScheduler;
+	float mIdleTimeSec;			// time for which nothing has been happening
+	bool mFirstFrameShown;
 	bool mQuit;
 	
-	float mAreaLeft, mAreaRight;	//
-	float mAreaTop, mAreaBottom;	// accessible play area
-	
+	World* mpWorld;				// the world on screen
+	RewindBuffer* mpRewindBuffer;	// null when headless
+	HashLog* mpHashLog;				// null unless logging state hashes with "--hash-log"
+	std::vector<uint8_t> mSnapshot;			// reused for each step
+	std::vector<uint8_t> mRetrySnapshot;	// the start of the current fare, or of the game
+	uint32_t mRetrySnapshotStep;
 	Music* mpMusic;
 	Sound* mpTestSound;
-	int mCash;
-	float mCountdownSec;
-	HouseEntity* mpCurrentHouse;
-	TargetEntity* mpCurrentTarget;
-	SpriteEntity* mpArrow;
-	
-	std::string mStatusMsg;
-	std::string mStatusMsg2;
-	float mMsgDisplayTimeSec;
 	
 };
 
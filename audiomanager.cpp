@@ -55,8 +55,7 @@ bool AudioManager::init()
 
 void AudioManager::shutDown()
 {
-	ASSERT(mInitialised);
-	
+	// The placeholder sounds and music are created even when uninitialised (e.g. in headless mode)
 	for (auto liSound: mRegisteredSounds)
 		delete liSound.second;
 	mRegisteredSounds.clear();
@@ -65,6 +64,9 @@ void AudioManager::shutDown()
 		delete liMusic.second;
 	mRegisteredMusic.clear();
 	
+	if (!mInitialised)
+		return;
+	
 	Mix_CloseAudio();
 	Mix_Quit();
 	
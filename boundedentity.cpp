@@ -10,23 +10,31 @@
 #include "texturemanager.h"
 #include "useful.h"
 
+#include <new>
+
 //------------------------------------------------------------------------------
 // Factory
 //------------------------------------------------------------------------------
 
-Entity* createBoundedEntity(const std::vector<std::string>& lrParams)
+Entity* createBoundedEntity(World* lpWorld, const std::vector<std::string>& lrParams)
 {
-	return new BoundedEntity(getFloatParam(lrParams, 0), getFloatParam(lrParams, 1));
+	return new BoundedEntity(lpWorld, getFloatParam(lrParams, 0), getFloatParam(lrParams, 1));
 }
 
-EntityFactory sBoundedEntityFactory("guard", &createBoundedEntity);
+// Parameters: x, y
+Entity* spawnBoundedEntity(World* lpWorld, void* lpMemory, const float* lpParams)
+{
+	return new (lpMemory) BoundedEntity(lpWorld, lpParams[0], lpParams[1]);
+}
+
+SpawnableEntityFactory<BoundedEntity> sBoundedEntityFactory("guard", &createBoundedEntity, &spawnBoundedEntity);
 
 //------------------------------------------------------------------------------
 // BoundedEntity
 //------------------------------------------------------------------------------
 
-BoundedEntity::BoundedEntity(float lX, float lY) :
-	SpriteEntity(lX, lY)
+BoundedEntity::BoundedEntity(World* lpWorld, float lX, float lY) :
+	SpriteEntity(lpWorld, lX, lY)
 {
 	setTexture(gTextureManager.load("data/guard.png"));
 	float lHalfWidth = width() * 0.5f;
@@ -39,30 +47,29 @@ BoundedEntity::BoundedEntity(float lX, float lY) :
 
 //------------------------------------------------------------------------------
 
-void BoundedEntity::update(float lTimeDeltaSec)
+void BoundedEntity::afterMove(float lTimeDeltaSec)
 {
-	SpriteEntity::update(lTimeDeltaSec);
-	
-	if (mX > mMaxX)
+	Transform& lrTransform = transform();
+	if (lrTransform.mX > mMaxX)
 	{
-		mX = mMaxX - (mX - mMaxX);
-		mVelX = -mVelX;
+		lrTransform.mX = mMaxX - (lrTransform.mX - mMaxX);
+		lrTransform.mVelX = -lrTransform.mVelX;
 	}
-	else if (mX < mMinX)
+	else if (lrTransform.mX < mMinX)
 	{
-		mX = mMinX + (mMinX - mX);
-		mVelX = -mVelX;
+		lrTransform.mX = mMinX + (mMinX - lrTransform.mX);
+		lrTransform.mVelX = -lrTransform.mVelX;
 	}
 	
-	if (mY >= mMaxY)
+	if (lrTransform.mY >= mMaxY)
 	{
-		mY = mMaxY - (mY - mMaxY);
-		mVelY = -mVelY;
+		lrTransform.mY = mMaxY - (lrTransform.mY - mMaxY);
+		lrTransform.mVelY = -lrTransform.mVelY;
 	}
-	else if (mY < mMinY)
+	else if (lrTransform.mY < mMinY)
 	{
-		mY = mMinY + (mMinY - mY);
-		mVelY = -mVelY;
+		lrTransform.mY = mMinY + (mMinY - lrTransform.mY);
+		lrTransform.mVelY = -lrTransform.mVelY;
 	}
 }
 
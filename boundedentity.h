@@ -16,11 +16,14 @@
 class BoundedEntity : public SpriteEntity
 {
 public:
-	BoundedEntity(float lX, float lY);
+	BoundedEntity(World* lpWorld, float lX, float lY);
 	
-	virtual const char* type() const { return "bounded"; }
+	static constexpr const char* kType = "bounded";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
-	virtual void update(float lTimeDeltaSec);
+	virtual void afterMove(float lTimeDeltaSec);
 	
 protected:
 	float minX() const { return mMinX; }
@@ -11,24 +11,16 @@
 
 //------------------------------------------------------------------------------
 
-Camera* gpCamera = nullptr;
-
-//------------------------------------------------------------------------------
-
-Camera::Camera(float lX, float lY, float lViewWidth, float lViewHeight) :
-	Entity(lX, lY)
+Camera::Camera(World* lpWorld, float lX, float lY, float lViewWidth, float lViewHeight) :
+	Entity(lpWorld, lX, lY)
 {
 	setSize(lViewWidth, lViewHeight);
-	if (gpCamera == nullptr)
-		gpCamera = this;
 }
 
 //------------------------------------------------------------------------------
 
 Camera::~Camera()
 {
-	if (gpCamera == this)
-		gpCamera = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -46,20 +38,20 @@ bool Camera::canSee(const Entity* lpTarget) const
 
 void Camera::updateFromPlayer(Entity *lpPlayer, float lMinX, float lMinY, float lMaxX, float lMaxY)
 {
-	float lMoveBorderPixels = Settings::getFloat("screen/camera_move_border");
+	static const float kMoveBorderPixels = Settings::getFloat("screen/camera_move_border");
 	
 	float lCameraX = this->x();
 	float lCameraY = this->y();
 	
-	if (lpPlayer->left() < left() + lMoveBorderPixels)
-		lCameraX = max(lpPlayer->left() - lMoveBorderPixels, lMinX) + halfWidth();
-	else if (lpPlayer->right() > right() - lMoveBorderPixels)
-		lCameraX = min(lpPlayer->right() + lMoveBorderPixels, lMaxX) - halfWidth();
+	if (lpPlayer->left() < left() + kMoveBorderPixels)
+		lCameraX = max(lpPlayer->left() - kMoveBorderPixels, lMinX) + halfWidth();
+	else if (lpPlayer->right() > right() - kMoveBorderPixels)
+		lCameraX = min(lpPlayer->right() + kMoveBorderPixels, lMaxX) - halfWidth();
 	
-	if (lpPlayer->top() < top() + lMoveBorderPixels)
-		lCameraY = max(lpPlayer->top() - lMoveBorderPixels, lMinY) + halfHeight();
-	else if (lpPlayer->bottom() > bottom() - lMoveBorderPixels)
-		lCameraY = min(lpPlayer->bottom() + lMoveBorderPixels, lMaxY) - halfHeight();
+	if (lpPlayer->top() < top() + kMoveBorderPixels)
+		lCameraY = max(lpPlayer->top() - kMoveBorderPixels, lMinY) + halfHeight();
+	else if (lpPlayer->bottom() > bottom() - kMoveBorderPixels)
+		lCameraY = min(lpPlayer->bottom() + kMoveBorderPixels, lMaxY) - halfHeight();
 	
 	//if (lCameraX != this->x() || lCameraY != this->y())
 		//printf("Moving camera from (%.1f, %.1f) to (%.1f, %.1f)\n", x(), y(), lCameraX, lCameraY);
@@ -14,10 +14,13 @@
 class Camera : public Entity
 {
 public:
-	Camera(float lX, float lY, float lViewWidth, float lViewHeight);
+	Camera(World* lpWorld, float lX, float lY, float lViewWidth, float lViewHeight);
 	~Camera();
 	
-	virtual const char* type() const { return "camera"; }
+	static constexpr const char* kType = "camera";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	void set(float lX, float lY, float lViewWidth, float lViewHeight) { setPos(lX, lY); setSize(lViewWidth, lViewHeight); }
 	
@@ -28,15 +31,13 @@ public:
 	
 	float offsetX() const	{ return x() - halfWidth(); }
 	float offsetY() const	{ return y() - halfHeight(); }
+	float renderOffsetX() const	{ return renderX() - halfWidth(); }
+	float renderOffsetY() const	{ return renderY() - halfHeight(); }
 	bool canSee(const Entity* lpTarget) const;
 	
 	void updateFromPlayer(Entity* lpPlayer, float lMinX, float lMinY, float lMaxX, float lMaxY);
-	
-private:
 };
 
-extern Camera* gpCamera;	// there may be more than one camera, but this points to the first one
-
 //------------------------------------------------------------------------------
 
 #endif // CAMERA_H
@@ -7,6 +7,7 @@
 #ifndef CARENTITY_H
 #define CARENTITY_H
 
+#include "carhandling.h"
 #include "spriteentity.h"
 
 //------------------------------------------------------------------------------
@@ -14,24 +15,36 @@
 class CarEntity : public CollidableEntity
 {
 public:
-	CarEntity(float lX, float lY, const std::string& lrColour);
+	CarEntity(World* lpWorld, float lX, float lY, const std::string& lrColour);
+	virtual ~CarEntity();
 	
-	virtual const char* type() const { return "car"; }
+	static constexpr const char* kType = "car";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	virtual void update(float lTimeDeltaSec);
+	virtual void afterMove(float lTimeDeltaSec) { enforceBoundaries(); }
+	virtual void saveState(SnapshotWriter& lrWriter) const;
+	virtual void loadState(SnapshotReader& lrReader);
 	
 	virtual float bounceFactor() const;
 	
+	// Turns the car's facing direction to match, as the handling steers by that rather than the angle
+	virtual void setRotationRad(float lRotation);
+	
+	bool hasControlInput() const { const CarPhysics& lrPhysics = carPhysics(); return lrPhysics.mAccelCtrl != 0.0f || lrPhysics.mSteerCtrl != 0.0f; }
+	
 protected:
 	
 	void enforceBoundaries();
 	void checkCollisions();
 	
-	float mSteerCtrl;			// <0 => left; >0 => right
-	float mAccelCtrl;			// >0 => accelerate; <0 => brake/reverse accelerate
-	float mLastAngle;			// last recorded velocity angle for the car
-	bool  mReversing;			// true while in reverse
-	float mSwitchDirTimeSec;	// time while holding the key to switch from forward to reverse, or vice versa
+	CarPhysics& carPhysics()				{ return components().carPhysics()[mCarPhysicsIndex]; }
+	const CarPhysics& carPhysics() const	{ return components().carPhysics()[mCarPhysicsIndex]; }
+	
+private:
+	int mCarPhysicsIndex;
 };
 
 //------------------------------------------------------------------------------
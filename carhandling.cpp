@@ -0,0 +1,481 @@
+//------------------------------------------------------------------------------
+// CarHandling: How cars respond to the controls - steering, acceleration,
+//              braking, grip and reversing - for one car at a time, or for a
+//              batch of cars at once with SIMD where the build allows it.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "carhandling.h"
+
+#include "settings.h"
+#include "useful.h"
+
+#include <cmath>
+#include <utility>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+
+void CarHandling::loadFromSettings()
+{
+	mSteerRadsPerSecLow		= Settings::getFloat("handling/steer_rads_per_sec_low");
+	mSteerRadsPerSecHigh	= Settings::getFloat("handling/steer_rads_per_sec_high");
+	mLowThreshold			= Settings::getFloat("handling/low_threshold");
+	mHighThreshold			= Settings::getFloat("handling/high_threshold");
+	mAccelPerSecLow			= Settings::getFloat("handling/accel_per_sec_low");
+	mAccelPerSecHigh		= Settings::getFloat("handling/accel_per_sec_high");
+	mNoAccelSlowing			= Settings::getFloat("handling/no_accel_slowing");
+	mBrakePerSec			= Settings::getFloat("handling/brake_per_sec");
+	mGrip					= Settings::getFloat("handling/grip");
+	mGripFactorWhenBraking	= Settings::getFloat("handling/grip_factor_when_braking");
+	mAutoreverseHoldTimeSec	= Settings::getFloat("handling/autoreverse_hold_time_sec");
+}
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	// Turns a unit vector through a small angle (a step's steering, well under a radian) with the angle's sine and
+	// cosine from their Taylor series, then scales it back to unit length with a step of Newton's method so that
+	// rounding doesn't build up from step to step.  A template, so that the batch version can share it.
+	template <typename Type> inline void turnDirection(Type lAngleRad, Type* lpX, Type* lpY)
+	{
+		Type lAngleSq = lAngleRad * lAngleRad;
+		Type lSin = lAngleRad * (Type(1.0f) - lAngleSq * (Type(1.0f / 6.0f) - lAngleSq * Type(1.0f / 120.0f)));
+		Type lCos = Type(1.0f) - lAngleSq * (Type(0.5f) - lAngleSq * (Type(1.0f / 24.0f) - lAngleSq * Type(1.0f / 720.0f)));
+		Type lX = *lpX * lCos - *lpY * lSin;
+		Type lY = *lpX * lSin + *lpY * lCos;
+		Type lScale = Type(1.5f) - Type(0.5f) * (lX * lX + lY * lY);
+		*lpX = lX * lScale;
+		*lpY = lY * lScale;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+bool updateCarHandling(const CarHandling& lrHandling, float lTimeDeltaSec, CarHandlingState* lpState)
+{
+	float lVelX = lpState->mVelX;
+	float lVelY = lpState->mVelY;
+	float lVelMag = sqrtf(lVelX * lVelX + lVelY * lVelY);
+	
+	// The velocity is split into speeds along the facing direction and across it (the tangent, a quarter turn on)
+	float lFacingXNorm = lpState->mFacingX;
+	float lFacingYNorm = lpState->mFacingY;
+	float lFacingSpeed = lVelX * lFacingXNorm + lVelY * lFacingYNorm;
+	
+	float lTangXNorm = -lFacingYNorm;
+	float lTangYNorm = lFacingXNorm;
+	float lTangSpeed = lVelX * lTangXNorm + lVelY * lTangYNorm;
+	
+	float lEffectiveAccelCtrl = max( lpState->mAccelCtrl, 0.0f);		// [0, 1]
+	float lEffectiveBrakeCtrl = max(-lpState->mAccelCtrl, 0.0f);		// [0, 1] - so positive when braking
+	
+	bool lMoving = true;
+	bool lSwitching = false;
+	if (floatApproxEquals(lVelMag, 0.0f))
+	{
+		lMoving = false;
+		if ((!lpState->mReversing && lpState->mAccelCtrl < 0.0f) || (lpState->mReversing && lpState->mAccelCtrl > 0.0f))
+		{
+			lpState->mSwitchDirTimeSec += lTimeDeltaSec;
+			if (lpState->mSwitchDirTimeSec >= lrHandling.mAutoreverseHoldTimeSec)
+			{
+				lpState->mReversing = !lpState->mReversing;
+				lpState->mSwitchDirTimeSec = 0.0f;
+			}
+			lEffectiveAccelCtrl = 0.0f;
+			lEffectiveBrakeCtrl = 0.0f;
+			lSwitching = true;
+		}
+	}
+	if (!lSwitching)
+		lpState->mSwitchDirTimeSec = 0.0f;
+	
+	if (lpState->mReversing)
+		std::swap(lEffectiveAccelCtrl, lEffectiveBrakeCtrl);
+	
+	//printf("Accel %.1f, brake %.1f, %s; current speed %.1f facing / %.1f tang\n",
+	//	   lEffectiveAccelCtrl, lEffectiveBrakeCtrl, lpState->mReversing ? "rev" : "fwd", lFacingSpeed, lTangSpeed);
+	
+	const float kSteerRadsPerSecLow		= lrHandling.mSteerRadsPerSecLow;
+	const float kSteerRadsPerSecHigh	= lrHandling.mSteerRadsPerSecHigh;
+	const float kLowThreshold			= lrHandling.mLowThreshold;
+	const float kHighThreshold			= lrHandling.mHighThreshold;
+	const float kAccelPerSecLow			= lrHandling.mAccelPerSecLow;
+	const float kAccelPerSecHigh		= lrHandling.mAccelPerSecHigh;
+	const float kNoAccelSlowing			= lrHandling.mNoAccelSlowing;
+	const float kBrakePerSec			= lrHandling.mBrakePerSec;
+	const float kGrip					= lrHandling.mGrip;
+	const float kGripFactorWhenBraking	= lrHandling.mGripFactorWhenBraking;
+	
+	float lLowHighFactor =  (lVelMag < kLowThreshold) ? 0.0f :
+							(lVelMag > kHighThreshold ? 1.0f :
+							((lVelMag - kLowThreshold) / (kHighThreshold - kLowThreshold)));
+	
+	// Steering (only while moving)
+	if (lVelMag > 0.0f && lpState->mSteerCtrl != 0.0f)
+	{
+		// Below the low threshold, steering drops to zero (can't turn when stationary)
+		float lSteerRadsPerSec = (lVelMag < kLowThreshold)
+								 ? lerp(lVelMag/ kLowThreshold, 0.0f, kSteerRadsPerSecLow)
+								 : lerp(lLowHighFactor, kSteerRadsPerSecLow, kSteerRadsPerSecHigh);
+		
+		float lTurnRad = lTimeDeltaSec * lSteerRadsPerSec * lpState->mSteerCtrl;
+		turnDirection(lTurnRad, &lpState->mFacingX, &lpState->mFacingY);
+		lpState->mRotationRad += lTurnRad;
+	}
+	
+	// Acceleration
+	if (lEffectiveAccelCtrl > 0.0f)
+	{
+		float lAccelPerSec = lerp(lLowHighFactor, kAccelPerSecLow, kAccelPerSecHigh);
+		float lAccelMag = lTimeDeltaSec * lAccelPerSec * lEffectiveAccelCtrl;
+		if (lpState->mReversing)
+			lAccelMag = -lAccelMag;
+		lFacingSpeed += lAccelMag;
+	}
+	else if (lEffectiveBrakeCtrl > 0.0f)
+	{
+		float lSign = sign(lFacingSpeed);
+		float lBrakeMag = lTimeDeltaSec * kBrakePerSec * lEffectiveBrakeCtrl;
+		lFacingSpeed = max(fabsf(lFacingSpeed) - lBrakeMag, 0.0f) * lSign;
+	}
+	// Apply in-line drag if moving
+	else if (!floatApproxEquals(lFacingSpeed, 0.0f))
+	{
+		float lSign = sign(lFacingSpeed);
+		lFacingSpeed = max(fabsf(lFacingSpeed) - lTimeDeltaSec * kNoAccelSlowing, 0.0f) * lSign;
+	}
+	
+	// Apply tangential drag
+	if (!floatApproxEquals(lTangSpeed, 0.0f))
+	{
+		float lGripFactor = kGrip;
+		if (lEffectiveBrakeCtrl < 0.0f)
+			lGripFactor *= kGripFactorWhenBraking;
+		lTangSpeed = max(lTangSpeed - lTimeDeltaSec * lGripFactor * kBrakePerSec, 0.0f);
+	}
+	
+	// Reconstruct velocity (from the directions before this step's steering, which shows in the next step)
+	lpState->mVelX = lFacingXNorm * lFacingSpeed + lTangXNorm * lTangSpeed;
+	lpState->mVelY = lFacingYNorm * lFacingSpeed + lTangYNorm * lTangSpeed;
+	return lMoving;
+}
+
+//------------------------------------------------------------------------------
+// CarHandlingBatch
+//------------------------------------------------------------------------------
+
+void CarHandlingBatch::resize(size_t lNumCars)
+{
+	mVelX.resize(lNumCars);
+	mVelY.resize(lNumCars);
+	mFacingX.resize(lNumCars);
+	mFacingY.resize(lNumCars);
+	mRotationRad.resize(lNumCars);
+	mSteerCtrl.resize(lNumCars);
+	mAccelCtrl.resize(lNumCars);
+	mSwitchDirTimeSec.resize(lNumCars);
+	mReversing.resize(lNumCars);
+	mMoving.resize(lNumCars);
+}
+
+//------------------------------------------------------------------------------
+
+void CarHandlingBatch::set(size_t lIndex, const CarHandlingState& lrState)
+{
+	mVelX[lIndex]				= lrState.mVelX;
+	mVelY[lIndex]				= lrState.mVelY;
+	mFacingX[lIndex]			= lrState.mFacingX;
+	mFacingY[lIndex]			= lrState.mFacingY;
+	mRotationRad[lIndex]		= lrState.mRotationRad;
+	mSteerCtrl[lIndex]			= lrState.mSteerCtrl;
+	mAccelCtrl[lIndex]			= lrState.mAccelCtrl;
+	mSwitchDirTimeSec[lIndex]	= lrState.mSwitchDirTimeSec;
+	mReversing[lIndex]			= lrState.mReversing ? 1.0f : 0.0f;
+}
+
+//------------------------------------------------------------------------------
+
+CarHandlingState CarHandlingBatch::get(size_t lIndex) const
+{
+	CarHandlingState lState;
+	lState.mVelX				= mVelX[lIndex];
+	lState.mVelY				= mVelY[lIndex];
+	lState.mFacingX				= mFacingX[lIndex];
+	lState.mFacingY				= mFacingY[lIndex];
+	lState.mRotationRad			= mRotationRad[lIndex];
+	lState.mSteerCtrl			= mSteerCtrl[lIndex];
+	lState.mAccelCtrl			= mAccelCtrl[lIndex];
+	lState.mSwitchDirTimeSec	= mSwitchDirTimeSec[lIndex];
+	lState.mReversing			= mReversing[lIndex] != 0.0f;
+	return lState;
+}
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	// Each SIMD width has a Floats type (a register of car values) and a Mask type (the result of comparing them),
+	// with just the operations the handling needs, so that the handling itself is only written once.  Comparisons
+	// and selects stand in for the reference version's branches: both sides are worked out for every car, and each
+	// car picks its own.
+
+#if defined(__AVX512F__)
+	
+	struct Mask
+	{
+		Mask(__mmask16 lBits) : mBits(lBits) {}
+		__mmask16 mBits;
+	};
+	inline Mask operator&(Mask lA, Mask lB)	{ return Mask(__mmask16(lA.mBits & lB.mBits)); }
+	inline Mask operator|(Mask lA, Mask lB)	{ return Mask(__mmask16(lA.mBits | lB.mBits)); }
+	inline Mask operator~(Mask lA)			{ return Mask(__mmask16(~lA.mBits)); }
+	
+	struct Floats
+	{
+		static const int kWidth = 16;
+		Floats(__m512 lVals) : mVals(lVals) {}
+		explicit Floats(float lVal) : mVals(_mm512_set1_ps(lVal)) {}
+		static Floats load(const float* lpVals)	{ return Floats(_mm512_loadu_ps(lpVals)); }
+		void store(float* lpVals) const			{ _mm512_storeu_ps(lpVals, mVals); }
+		__m512 mVals;
+	};
+	inline Floats operator+(Floats lA, Floats lB)	{ return Floats(_mm512_add_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator-(Floats lA, Floats lB)	{ return Floats(_mm512_sub_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator*(Floats lA, Floats lB)	{ return Floats(_mm512_mul_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator/(Floats lA, Floats lB)	{ return Floats(_mm512_div_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator-(Floats lA)				{ return Floats(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(lA.mVals), _mm512_set1_epi32(int(0x80000000))))); }
+	inline Mask operator<(Floats lA, Floats lB)		{ return Mask(_mm512_cmp_ps_mask(lA.mVals, lB.mVals, _CMP_LT_OQ)); }
+	inline Mask operator>(Floats lA, Floats lB)		{ return Mask(_mm512_cmp_ps_mask(lA.mVals, lB.mVals, _CMP_GT_OQ)); }
+	inline Mask operator>=(Floats lA, Floats lB)	{ return Mask(_mm512_cmp_ps_mask(lA.mVals, lB.mVals, _CMP_GE_OQ)); }
+	inline Mask operator!=(Floats lA, Floats lB)	{ return Mask(_mm512_cmp_ps_mask(lA.mVals, lB.mVals, _CMP_NEQ_UQ)); }
+	inline Floats min(Floats lA, Floats lB)			{ return Floats(_mm512_min_ps(lA.mVals, lB.mVals)); }
+	inline Floats max(Floats lA, Floats lB)			{ return Floats(_mm512_max_ps(lA.mVals, lB.mVals)); }
+	inline Floats abs(Floats lA)					{ return Floats(_mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(lA.mVals), _mm512_set1_epi32(0x7fffffff)))); }
+	inline Floats sqrt(Floats lA)					{ return Floats(_mm512_sqrt_ps(lA.mVals)); }
+	inline Floats select(Mask lMask, Floats lIfSet, Floats lIfClear)	{ return Floats(_mm512_mask_blend_ps(lMask.mBits, lIfClear.mVals, lIfSet.mVals)); }
+
+#elif defined(__AVX__)
+	
+	struct Mask
+	{
+		Mask(__m256 lBits) : mBits(lBits) {}
+		__m256 mBits;
+	};
+	inline Mask operator&(Mask lA, Mask lB)	{ return Mask(_mm256_and_ps(lA.mBits, lB.mBits)); }
+	inline Mask operator|(Mask lA, Mask lB)	{ return Mask(_mm256_or_ps(lA.mBits, lB.mBits)); }
+	inline Mask operator~(Mask lA)			{ return Mask(_mm256_xor_ps(lA.mBits, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))); }
+	
+	struct Floats
+	{
+		static const int kWidth = 8;
+		Floats(__m256 lVals) : mVals(lVals) {}
+		explicit Floats(float lVal) : mVals(_mm256_set1_ps(lVal)) {}
+		static Floats load(const float* lpVals)	{ return Floats(_mm256_loadu_ps(lpVals)); }
+		void store(float* lpVals) const			{ _mm256_storeu_ps(lpVals, mVals); }
+		__m256 mVals;
+	};
+	inline Floats operator+(Floats lA, Floats lB)	{ return Floats(_mm256_add_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator-(Floats lA, Floats lB)	{ return Floats(_mm256_sub_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator*(Floats lA, Floats lB)	{ return Floats(_mm256_mul_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator/(Floats lA, Floats lB)	{ return Floats(_mm256_div_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator-(Floats lA)				{ return Floats(_mm256_xor_ps(lA.mVals, _mm256_set1_ps(-0.0f))); }
+	inline Mask operator<(Floats lA, Floats lB)		{ return Mask(_mm256_cmp_ps(lA.mVals, lB.mVals, _CMP_LT_OQ)); }
+	inline Mask operator>(Floats lA, Floats lB)		{ return Mask(_mm256_cmp_ps(lA.mVals, lB.mVals, _CMP_GT_OQ)); }
+	inline Mask operator>=(Floats lA, Floats lB)	{ return Mask(_mm256_cmp_ps(lA.mVals, lB.mVals, _CMP_GE_OQ)); }
+	inline Mask operator!=(Floats lA, Floats lB)	{ return Mask(_mm256_cmp_ps(lA.mVals, lB.mVals, _CMP_NEQ_UQ)); }
+	inline Floats min(Floats lA, Floats lB)			{ return Floats(_mm256_min_ps(lA.mVals, lB.mVals)); }
+	inline Floats max(Floats lA, Floats lB)			{ return Floats(_mm256_max_ps(lA.mVals, lB.mVals)); }
+	inline Floats abs(Floats lA)					{ return Floats(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), lA.mVals)); }
+	inline Floats sqrt(Floats lA)					{ return Floats(_mm256_sqrt_ps(lA.mVals)); }
+	inline Floats select(Mask lMask, Floats lIfSet, Floats lIfClear)	{ return Floats(_mm256_blendv_ps(lIfClear.mVals, lIfSet.mVals, lMask.mBits)); }
+
+#elif defined(__SSE2__)
+	
+	struct Mask
+	{
+		Mask(__m128 lBits) : mBits(lBits) {}
+		__m128 mBits;
+	};
+	inline Mask operator&(Mask lA, Mask lB)	{ return Mask(_mm_and_ps(lA.mBits, lB.mBits)); }
+	inline Mask operator|(Mask lA, Mask lB)	{ return Mask(_mm_or_ps(lA.mBits, lB.mBits)); }
+	inline Mask operator~(Mask lA)			{ return Mask(_mm_xor_ps(lA.mBits, _mm_castsi128_ps(_mm_set1_epi32(-1)))); }
+	
+	struct Floats
+	{
+		static const int kWidth = 4;
+		Floats(__m128 lVals) : mVals(lVals) {}
+		explicit Floats(float lVal) : mVals(_mm_set1_ps(lVal)) {}
+		static Floats load(const float* lpVals)	{ return Floats(_mm_loadu_ps(lpVals)); }
+		void store(float* lpVals) const			{ _mm_storeu_ps(lpVals, mVals); }
+		__m128 mVals;
+	};
+	inline Floats operator+(Floats lA, Floats lB)	{ return Floats(_mm_add_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator-(Floats lA, Floats lB)	{ return Floats(_mm_sub_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator*(Floats lA, Floats lB)	{ return Floats(_mm_mul_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator/(Floats lA, Floats lB)	{ return Floats(_mm_div_ps(lA.mVals, lB.mVals)); }
+	inline Floats operator-(Floats lA)				{ return Floats(_mm_xor_ps(lA.mVals, _mm_set1_ps(-0.0f))); }
+	inline Mask operator<(Floats lA, Floats lB)		{ return Mask(_mm_cmplt_ps(lA.mVals, lB.mVals)); }
+	inline Mask operator>(Floats lA, Floats lB)		{ return Mask(_mm_cmpgt_ps(lA.mVals, lB.mVals)); }
+	inline Mask operator>=(Floats lA, Floats lB)	{ return Mask(_mm_cmpge_ps(lA.mVals, lB.mVals)); }
+	inline Mask operator!=(Floats lA, Floats lB)	{ return Mask(_mm_cmpneq_ps(lA.mVals, lB.mVals)); }
+	inline Floats min(Floats lA, Floats lB)			{ return Floats(_mm_min_ps(lA.mVals, lB.mVals)); }
+	inline Floats max(Floats lA, Floats lB)			{ return Floats(_mm_max_ps(lA.mVals, lB.mVals)); }
+	inline Floats abs(Floats lA)					{ return Floats(_mm_andnot_ps(_mm_set1_ps(-0.0f), lA.mVals)); }
+	inline Floats sqrt(Floats lA)					{ return Floats(_mm_sqrt_ps(lA.mVals)); }
+	inline Floats select(Mask lMask, Floats lIfSet, Floats lIfClear)	{ return Floats(_mm_or_ps(_mm_and_ps(lMask.mBits, lIfSet.mVals), _mm_andnot_ps(lMask.mBits, lIfClear.mVals))); }
+
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+	
+	const int kBatchWidth = Floats::kWidth;
+	
+	inline Mask approxZero(Floats lVal)
+	{
+		// As floatApproxEquals(lVal, 0.0f)
+		const Floats kZero(0.0f);
+		const Floats kEpsilon(1.0e-6f);
+		return (lVal - kEpsilon < kZero) & (kZero < lVal + kEpsilon);
+	}
+	
+	inline Floats lerp(Floats lFactor, Floats lVal1, Floats lVal2)
+	{
+		lFactor = max(Floats(0.0f), min(lFactor, Floats(1.0f)));		// as clamp()
+		return lVal1 + (lVal2 - lVal1) * lFactor;
+	}
+	
+	// The same steps as updateCarHandling(), for kBatchWidth cars from lIndex
+	void updateCarHandlingLanes(const CarHandling& lrHandling, float lTimeDeltaSec, CarHandlingBatch* lpBatch, size_t lIndex)
+	{
+		const Floats kZero(0.0f);
+		const Floats kOne(1.0f);
+		const Floats kTimeDeltaSec(lTimeDeltaSec);
+		const Floats kSteerRadsPerSecLow(lrHandling.mSteerRadsPerSecLow);
+		const Floats kSteerRadsPerSecHigh(lrHandling.mSteerRadsPerSecHigh);
+		const Floats kLowThreshold(lrHandling.mLowThreshold);
+		const Floats kHighThreshold(lrHandling.mHighThreshold);
+		const Floats kThresholdRange(lrHandling.mHighThreshold - lrHandling.mLowThreshold);
+		const Floats kAccelPerSecLow(lrHandling.mAccelPerSecLow);
+		const Floats kAccelPerSecHigh(lrHandling.mAccelPerSecHigh);
+		const Floats kSlowingMag(lTimeDeltaSec * lrHandling.mNoAccelSlowing);
+		const Floats kBrakeMagPerCtrl(lTimeDeltaSec * lrHandling.mBrakePerSec);
+		const Floats kGripMag(lTimeDeltaSec * lrHandling.mGrip * lrHandling.mBrakePerSec);
+		const Floats kAutoreverseHoldTimeSec(lrHandling.mAutoreverseHoldTimeSec);
+		
+		Floats lVelX = Floats::load(&lpBatch->mVelX[lIndex]);
+		Floats lVelY = Floats::load(&lpBatch->mVelY[lIndex]);
+		Floats lFacingXNorm = Floats::load(&lpBatch->mFacingX[lIndex]);
+		Floats lFacingYNorm = Floats::load(&lpBatch->mFacingY[lIndex]);
+		Floats lRotationRad = Floats::load(&lpBatch->mRotationRad[lIndex]);
+		Floats lSteerCtrl = Floats::load(&lpBatch->mSteerCtrl[lIndex]);
+		Floats lAccelCtrl = Floats::load(&lpBatch->mAccelCtrl[lIndex]);
+		Floats lSwitchDirTimeSec = Floats::load(&lpBatch->mSwitchDirTimeSec[lIndex]);
+		Mask lReversing = Floats::load(&lpBatch->mReversing[lIndex]) != kZero;
+		
+		Floats lVelMag = sqrt(lVelX * lVelX + lVelY * lVelY);
+		
+		// The tangent is the facing direction turned a quarter
+		Floats lTangXNorm = -lFacingYNorm;
+		Floats lTangYNorm = lFacingXNorm;
+		Floats lFacingSpeed = lVelX * lFacingXNorm + lVelY * lFacingYNorm;
+		Floats lTangSpeed = lVelX * lTangXNorm + lVelY * lTangYNorm;
+		
+		Floats lEffectiveAccelCtrl = max( lAccelCtrl, kZero);
+		Floats lEffectiveBrakeCtrl = max(-lAccelCtrl, kZero);
+		
+		// Holding the opposite control while stopped switches between forwards and reverse
+		Mask lMoving = ~approxZero(lVelMag);
+		Mask lSwitching = ~lMoving & ((~lReversing & (lAccelCtrl < kZero)) | (lReversing & (lAccelCtrl > kZero)));
+		lSwitchDirTimeSec = select(lSwitching, lSwitchDirTimeSec + kTimeDeltaSec, kZero);
+		Mask lSwitched = lSwitching & (lSwitchDirTimeSec >= kAutoreverseHoldTimeSec);
+		lReversing = (lReversing & ~lSwitched) | (~lReversing & lSwitched);
+		lSwitchDirTimeSec = select(lSwitched, kZero, lSwitchDirTimeSec);
+		lEffectiveAccelCtrl = select(lSwitching, kZero, lEffectiveAccelCtrl);
+		lEffectiveBrakeCtrl = select(lSwitching, kZero, lEffectiveBrakeCtrl);
+		
+		Floats lSwappedAccelCtrl = select(lReversing, lEffectiveBrakeCtrl, lEffectiveAccelCtrl);
+		lEffectiveBrakeCtrl = select(lReversing, lEffectiveAccelCtrl, lEffectiveBrakeCtrl);
+		lEffectiveAccelCtrl = lSwappedAccelCtrl;
+		
+		Floats lLowHighFactor = select(lVelMag < kLowThreshold, kZero,
+									   select(lVelMag > kHighThreshold, kOne, (lVelMag - kLowThreshold) / kThresholdRange));
+		
+		// Steering
+		Floats lSteerRadsPerSec = select(lVelMag < kLowThreshold, lerp(lVelMag / kLowThreshold, kZero, kSteerRadsPerSecLow),
+										 lerp(lLowHighFactor, kSteerRadsPerSecLow, kSteerRadsPerSecHigh));
+		Mask lSteering = (lVelMag > kZero) & (lSteerCtrl != kZero);
+		Floats lTurnRad = kTimeDeltaSec * lSteerRadsPerSec * lSteerCtrl;
+		Floats lTurnedXNorm = lFacingXNorm;
+		Floats lTurnedYNorm = lFacingYNorm;
+		turnDirection(lTurnRad, &lTurnedXNorm, &lTurnedYNorm);
+		lRotationRad = select(lSteering, lRotationRad + lTurnRad, lRotationRad);
+		
+		// Acceleration, braking or drag
+		Floats lAccelMag = kTimeDeltaSec * lerp(lLowHighFactor, kAccelPerSecLow, kAccelPerSecHigh) * lEffectiveAccelCtrl;
+		lAccelMag = select(lReversing, -lAccelMag, lAccelMag);
+		Floats lSign = select(lFacingSpeed >= kZero, kOne, -kOne);
+		Floats lBrakedSpeed = max(abs(lFacingSpeed) - kBrakeMagPerCtrl * lEffectiveBrakeCtrl, kZero) * lSign;
+		Floats lSlowedSpeed = max(abs(lFacingSpeed) - kSlowingMag, kZero) * lSign;
+		Mask lAccelerating = lEffectiveAccelCtrl > kZero;
+		Mask lBraking = lEffectiveBrakeCtrl > kZero;
+		lFacingSpeed = select(lAccelerating, lFacingSpeed + lAccelMag,
+							  select(lBraking, lBrakedSpeed,
+									 select(approxZero(lFacingSpeed), lFacingSpeed, lSlowedSpeed)));
+		
+		// Tangential drag (the brake control is never negative, so the grip factor for braking never applies)
+		lTangSpeed = select(approxZero(lTangSpeed), lTangSpeed, max(lTangSpeed - kGripMag, kZero));
+		
+		lVelX = lFacingXNorm * lFacingSpeed + lTangXNorm * lTangSpeed;
+		lVelY = lFacingYNorm * lFacingSpeed + lTangYNorm * lTangSpeed;
+		
+		lVelX.store(&lpBatch->mVelX[lIndex]);
+		lVelY.store(&lpBatch->mVelY[lIndex]);
+		select(lSteering, lTurnedXNorm, lFacingXNorm).store(&lpBatch->mFacingX[lIndex]);
+		select(lSteering, lTurnedYNorm, lFacingYNorm).store(&lpBatch->mFacingY[lIndex]);
+		lRotationRad.store(&lpBatch->mRotationRad[lIndex]);
+		lSwitchDirTimeSec.store(&lpBatch->mSwitchDirTimeSec[lIndex]);
+		select(lReversing, kOne, kZero).store(&lpBatch->mReversing[lIndex]);
+		select(lMoving, kOne, kZero).store(&lpBatch->mMoving[lIndex]);
+	}
+
+#else
+	
+	const int kBatchWidth = 1;
+
+#endif
+}
+
+//------------------------------------------------------------------------------
+
+void updateCarHandlingBatch(const CarHandling& lrHandling, float lTimeDeltaSec, CarHandlingBatch* lpBatch)
+{
+	size_t lNumCars = lpBatch->size();
+	size_t lIndex = 0;
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE2__)
+	for (; lIndex + kBatchWidth <= lNumCars; lIndex += kBatchWidth)
+		updateCarHandlingLanes(lrHandling, lTimeDeltaSec, lpBatch, lIndex);
+#endif
+	
+	for (; lIndex < lNumCars; ++lIndex)
+	{
+		CarHandlingState lState = lpBatch->get(lIndex);
+		lpBatch->mMoving[lIndex] = updateCarHandling(lrHandling, lTimeDeltaSec, &lState) ? 1.0f : 0.0f;
+		lpBatch->set(lIndex, lState);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+int carHandlingBatchWidth()
+{
+	return kBatchWidth;
+}
+
+//------------------------------------------------------------------------------
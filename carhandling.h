@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+// CarHandling: How cars respond to the controls - steering, acceleration,
+//              braking, grip and reversing - for one car at a time, or for a
+//              batch of cars at once with SIMD where the build allows it.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef CARHANDLING_H
+#define CARHANDLING_H
+
+#include <cstddef>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+// Handling parameters.  Each world has its own copy, so they can be varied between worlds (e.g. for tuning).
+struct CarHandling
+{
+	void loadFromSettings();
+	
+	float mSteerRadsPerSecLow;
+	float mSteerRadsPerSecHigh;
+	float mLowThreshold;
+	float mHighThreshold;
+	float mAccelPerSecLow;
+	float mAccelPerSecHigh;
+	float mNoAccelSlowing;
+	float mBrakePerSec;
+	float mGrip;
+	float mGripFactorWhenBraking;
+	float mAutoreverseHoldTimeSec;
+};
+
+//------------------------------------------------------------------------------
+
+// What the handling reads and changes for one car.  The handling works from the facing direction, turning it a little
+// each step, so that it needs no sines, cosines or arctangents; the rotation turns along with it, for drawing.
+struct CarHandlingState
+{
+	float mVelX;
+	float mVelY;
+	float mFacingX;			// unit vector
+	float mFacingY;			//
+	float mRotationRad;
+	float mSteerCtrl;
+	float mAccelCtrl;
+	float mSwitchDirTimeSec;
+	bool mReversing;
+};
+
+// Returns whether the car was moving (only then does it need to check for collisions).  This is the reference version
+// of the handling: cars in the game use it, and the batch version is checked against it.
+bool updateCarHandling(const CarHandling& lrHandling, float lTimeDeltaSec, CarHandlingState* lpState);
+
+//------------------------------------------------------------------------------
+
+// Many cars' handling states as a structure of arrays, so that a SIMD register can be loaded with several cars' values
+// at once
+struct CarHandlingBatch
+{
+	void resize(size_t lNumCars);
+	size_t size() const { return mVelX.size(); }
+	
+	void set(size_t lIndex, const CarHandlingState& lrState);
+	CarHandlingState get(size_t lIndex) const;
+	bool wasMoving(size_t lIndex) const { return mMoving[lIndex] != 0.0f; }
+	
+	std::vector<float> mVelX;
+	std::vector<float> mVelY;
+	std::vector<float> mFacingX;
+	std::vector<float> mFacingY;
+	std::vector<float> mRotationRad;
+	std::vector<float> mSteerCtrl;
+	std::vector<float> mAccelCtrl;
+	std::vector<float> mSwitchDirTimeSec;
+	std::vector<float> mReversing;		// 1 or 0, so it can be loaded like the rest
+	std::vector<float> mMoving;			// out: 1 or 0
+};
+
+// Updates every car in the batch, carHandlingBatchWidth() cars per instruction, with the odd ones at the end done by
+// updateCarHandling().  The sums are the same and in the same order, so the results match updateCarHandling()'s
+// exactly, as long as the compiler doesn't fuse multiplies and adds in one and not the other (the native build turns
+// that off).
+void updateCarHandlingBatch(const CarHandling& lrHandling, float lTimeDeltaSec, CarHandlingBatch* lpBatch);
+int carHandlingBatchWidth();		// 16, 8 or 4 with AVX-512, AVX or SSE2; 1 where there's no SIMD (e.g. the web)
+
+//------------------------------------------------------------------------------
+
+#endif // CARHANDLING_H
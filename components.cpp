@@ -0,0 +1,35 @@
+//------------------------------------------------------------------------------
+// Components: The entities' data, kept in packed arrays by kind, so that the
+//             systems that run over every entity (integration, timers, etc.)
+//             stream through just the data they need.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "components.h"
+
+//------------------------------------------------------------------------------
+
+void ComponentStore::savePreviousStates()
+{
+	for (Transform& lrTransform: mTransforms)
+	{
+		lrTransform.mPrevX = lrTransform.mX;
+		lrTransform.mPrevY = lrTransform.mY;
+	}
+	for (Sprite& lrSprite: mSprites)
+		lrSprite.mPrevRotationRad = lrSprite.mRotationRad;
+}
+
+//------------------------------------------------------------------------------
+
+void ComponentStore::integrate(float lTimeDeltaSec)
+{
+	for (Transform& lrTransform: mTransforms)
+	{
+		lrTransform.mX += lrTransform.mVelX * lTimeDeltaSec;
+		lrTransform.mY += lrTransform.mVelY * lTimeDeltaSec;
+	}
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,160 @@
+//------------------------------------------------------------------------------
+// Components: The entities' data, kept in packed arrays by kind, so that the
+//             systems that run over every entity (integration, timers, etc.)
+//             stream through just the data they need.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class Texture;
+
+//------------------------------------------------------------------------------
+
+// Every entity has one of these
+struct Transform
+{
+	float mX;
+	float mY;
+	float mVelX;
+	float mVelY;
+	float mPrevX;		// at the start of the step, for render interpolation
+	float mPrevY;
+	float mWidth;
+	float mHeight;
+};
+
+//------------------------------------------------------------------------------
+
+struct Sprite
+{
+	Texture* mpTexture;
+	float mRotationRad;
+	float mPrevRotationRad;
+	float mColour[4];			// ARGB
+	bool mRotationStartsFromUp;
+	bool mBlendEnabled;
+	bool mBehindCamera;			// the sprite's position is only affected by camera movement if this is false
+	bool mVisible;
+};
+
+//------------------------------------------------------------------------------
+
+struct Collider
+{
+	bool mUsesCircleCollisions;
+	bool mCollisionTriggersEvent;
+	uint32_t mQuietUntilStep;	// no crash sounds before this step
+};
+
+//------------------------------------------------------------------------------
+
+struct CarPhysics
+{
+	float mSteerCtrl;			// <0 => left; >0 => right
+	float mAccelCtrl;			// >0 => accelerate; <0 => brake/reverse accelerate
+	float mFacingX;				// unit vector the car faces; CarEntity::setRotationRad() keeps it with the sprite's
+	float mFacingY;				// rotation
+	bool  mReversing;			// true while in reverse
+	float mSwitchDirTimeSec;	// time while holding the key to switch from forward to reverse, or vice versa
+};
+
+//------------------------------------------------------------------------------
+
+// Removing a component moves the last one into the gap, so the array stays packed.  Each owner keeps the index of
+// its component, and passes in where it keeps it, so that it can be updated when the component moves.
+//
+// The active components (those of awake entities) are kept before the inactive ones, and iterating only goes over
+// the active ones, so the systems skip sleeping entities without checking each one.  New components are active.
+template <typename Component> class ComponentArray
+{
+public:
+	ComponentArray() : mNumActive(0) {}
+	
+	void add(int* lpOwnerIndex, const Component& lrComponent)
+	{
+		*lpOwnerIndex = int(mComponents.size());
+		mComponents.push_back(lrComponent);
+		mOwnerIndices.push_back(lpOwnerIndex);
+		swap(*lpOwnerIndex, int(mNumActive++));
+	}
+	void remove(int lIndex)
+	{
+		// Keep the active ones together: the last active one fills the gap, and the last one fills its place
+		if (size_t(lIndex) < mNumActive)
+		{
+			swap(lIndex, int(--mNumActive));
+			lIndex = int(mNumActive);
+		}
+		swap(lIndex, int(mComponents.size()) - 1);
+		mComponents.pop_back();
+		mOwnerIndices.pop_back();
+	}
+	void setActive(int lIndex, bool lActive)
+	{
+		if (lActive && size_t(lIndex) >= mNumActive)
+			swap(lIndex, int(mNumActive++));
+		else if (!lActive && size_t(lIndex) < mNumActive)
+			swap(lIndex, int(--mNumActive));
+	}
+	
+	Component& operator[](int lIndex)				{ return mComponents[lIndex]; }
+	const Component& operator[](int lIndex) const	{ return mComponents[lIndex]; }
+	size_t size() const								{ return mComponents.size(); }
+	size_t numActive() const						{ return mNumActive; }
+	
+	typename std::vector<Component>::iterator begin()	{ return mComponents.begin(); }
+	typename std::vector<Component>::iterator end()		{ return mComponents.begin() + mNumActive; }
+	
+private:
+	void swap(int lIndex1, int lIndex2)
+	{
+		if (lIndex1 == lIndex2)
+			return;
+		std::swap(mComponents[lIndex1], mComponents[lIndex2]);
+		std::swap(mOwnerIndices[lIndex1], mOwnerIndices[lIndex2]);
+		*mOwnerIndices[lIndex1] = lIndex1;
+		*mOwnerIndices[lIndex2] = lIndex2;
+	}
+	
+	std::vector<Component> mComponents;
+	std::vector<int*> mOwnerIndices;
+	size_t mNumActive;
+};
+
+//------------------------------------------------------------------------------
+
+// Each world has its own store, owned by its entity manager
+class ComponentStore
+{
+public:
+	ComponentArray<Transform>& transforms()		{ return mTransforms; }
+	ComponentArray<Sprite>& sprites()			{ return mSprites; }
+	ComponentArray<Collider>& colliders()		{ return mColliders; }
+	ComponentArray<CarPhysics>& carPhysics()	{ return mCarPhysics; }
+	
+	// The systems.  These run over the active components, whether their entities are alive or not; dead entities
+	// aren't saved or shown, and they get their state back from the snapshot if rewinding revives them.  Sleeping
+	// entities' components are inactive, so they're left as they are.
+	void savePreviousStates();
+	void integrate(float lTimeDeltaSec);
+	
+private:
+	ComponentArray<Transform> mTransforms;
+	ComponentArray<Sprite> mSprites;
+	ComponentArray<Collider> mColliders;
+	ComponentArray<CarPhysics> mCarPhysics;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // COMPONENTS_H
@@ -6,7 +6,10 @@
 
 #include "entity.h"
 
+#include "snapshot.h"
+#include "statehash.h"
 #include "useful.h"
+#include "world.h"
 #include <SDL/SDL_surface.h>
 #include <cmath>
 
@@ -14,37 +17,162 @@
 // Entity
 //------------------------------------------------------------------------------
 
-Entity::Entity(float lX, float lY) :
-	mX(lX),
-	mY(lY),
-	mVelX(0.0f),
-	mVelY(0.0f),
-	mWidth(0.0f),
-	mHeight(0.0f),
-	mAlive(true)
+float Entity::msRenderInterp = 1.0f;
+
+//------------------------------------------------------------------------------
+
+Entity::Entity(World* lpWorld, float lX, float lY) :
+	Entity(lpWorld->entities().components(), lX, lY)
+{
+	mpWorld = lpWorld;
+}
+
+//------------------------------------------------------------------------------
+
+Entity::Entity(ComponentStore& lrComponents, float lX, float lY) :
+	mNumTags(0),
+	mAlive(true),
+	mActivity(kAlwaysActive),
+	mAwake(true),
+	mJustWoken(false),
+	mSerial(0),
+	mLodSkippedSec(0.0f),
+	mpWorld(nullptr),
+	mpComponents(&lrComponents),
+	mpPool(nullptr),
+	mTransformIndex(-1)
+{
+	Transform lTransform = { lX, lY, 0.0f, 0.0f, lX, lY, 0.0f, 0.0f };
+	mpComponents->transforms().add(&mTransformIndex, lTransform);
+}
+
+//------------------------------------------------------------------------------
+
+Entity::~Entity()
+{
+	mpComponents->transforms().remove(mTransformIndex);
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::addTag(Name lTag)
+{
+	ASSERT(mHandle.isNull());		// not registered yet
+	if (hasTag(lTag))
+		return;
+	ASSERT(mNumTags < kMaxTags);
+	mTags[mNumTags++] = lTag;
+}
+
+//------------------------------------------------------------------------------
+
+bool Entity::hasTag(Name lTag) const
+{
+	for (int lIndex = 0; lIndex < mNumTags; ++lIndex)
+		if (mTags[lIndex] == lTag)
+			return true;
+	return false;
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::wake()
+{
+	if (mAwake || mActivity != kSleepy || mHandle.isNull())
+		return;
+	mpWorld->entities().wake(this);
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::setAwake(bool lAwake)
+{
+	if (lAwake != mAwake)
+		setComponentsActive(lAwake);
+	mAwake = lAwake;
+	mJustWoken = lAwake;
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::setComponentsActive(bool lActive)
+{
+	mpComponents->transforms().setActive(mTransformIndex, lActive);
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::savePreviousState()
+{
+	Transform& lrTransform = transform();
+	lrTransform.mPrevX = lrTransform.mX;
+	lrTransform.mPrevY = lrTransform.mY;
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::saveState(SnapshotWriter& lrWriter) const
+{
+	const Transform& lrTransform = transform();
+	lrWriter.write(lrTransform.mX);
+	lrWriter.write(lrTransform.mY);
+	lrWriter.write(lrTransform.mVelX);
+	lrWriter.write(lrTransform.mVelY);
+	lrWriter.write(lrTransform.mPrevX);
+	lrWriter.write(lrTransform.mPrevY);
+	lrWriter.write(uint8_t(mAlive));
+	lrWriter.write(uint8_t(mAwake));
+	lrWriter.write(uint8_t(mJustWoken));
+	lrWriter.write(mLodSkippedSec);
+}
+
+//------------------------------------------------------------------------------
+
+void Entity::loadState(SnapshotReader& lrReader)
 {
+	Transform& lrTransform = transform();
+	lrReader.read(&lrTransform.mX);
+	lrReader.read(&lrTransform.mY);
+	lrReader.read(&lrTransform.mVelX);
+	lrReader.read(&lrTransform.mVelY);
+	lrReader.read(&lrTransform.mPrevX);
+	lrReader.read(&lrTransform.mPrevY);
+	uint8_t lAlive;
+	lrReader.read(&lAlive);
+	mAlive = lAlive != 0;
+	uint8_t lAwake, lJustWoken;
+	lrReader.read(&lAwake);
+	lrReader.read(&lJustWoken);
+	setAwake(lAwake != 0);
+	mJustWoken = lJustWoken != 0;
+	lrReader.read(&mLodSkippedSec);
 }
 
 //------------------------------------------------------------------------------
 
-void Entity::update(float lTimeDeltaSec)
+void Entity::addToHash(StateHash& lrHash) const
 {
-	mX += mVelX * lTimeDeltaSec;
-	mY += mVelY * lTimeDeltaSec;
+	const Transform& lrTransform = transform();
+	lrHash.add(lrTransform.mX);
+	lrHash.add(lrTransform.mY);
+	lrHash.add(lrTransform.mVelX);
+	lrHash.add(lrTransform.mVelY);
+	lrHash.add(mAlive);
 }
 
 //------------------------------------------------------------------------------
 
 void Entity::getSpeedAndDir(float* lpSpeedOut, float* lpDirRadOut) const
 {
-	getPolarFromRect(mVelX, mVelY, lpSpeedOut, lpDirRadOut);
+	getPolarFromRect(velX(), velY(), lpSpeedOut, lpDirRadOut);
 }
 
 //------------------------------------------------------------------------------
 
 float Entity::speed() const
 {
-	return sqrtf(mVelX * mVelX + mVelY * mVelY);
+	const Transform& lrTransform = transform();
+	return sqrtf(lrTransform.mVelX * lrTransform.mVelX + lrTransform.mVelY * lrTransform.mVelY);
 }
 
 //------------------------------------------------------------------------------
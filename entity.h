@@ -7,78 +7,206 @@
 #ifndef ENTITY_H
 #define ENTITY_H
 
+#include "components.h"
+#include "name.h"
+
+#include <cstdint>
 #include <string>
 #include <vector>
 
 //------------------------------------------------------------------------------
 
 struct SDL_Surface;
+class EntityPool;
+class SnapshotReader;
+class SnapshotWriter;
+class StateHash;
+class World;
 
 //------------------------------------------------------------------------------
 
-class Entity
+// Entity types are identified by a hash (FNV-1a) of their names, which is worked out at compile time for each class's
+// kTypeId.  The factories are keyed the same way.
+typedef uint32_t EntityTypeId;
+constexpr EntityTypeId entityTypeId(const char* lpName, EntityTypeId lHash = 2166136261u)
+{
+	return *lpName == '\0' ? lHash : entityTypeId(lpName + 1, (lHash ^ uint8_t(*lpName)) * 16777619u);
+}
+
+//------------------------------------------------------------------------------
+
+// A reference to an entity that's safe to keep between steps: the index of the entity's slot in its entity manager,
+// plus the generation of the slot, which goes up each time the slot is reused.  Resolving a handle is an array lookup,
+// and gives null once the entity has been reclaimed.  The default handle is null (generations start from 1).
+class EntityHandle
 {
 public:
-	Entity(float lX, float lY);
-	virtual ~Entity() {}
+	static const int kIndexBits = 20;		// up to a million entities at once
+	static const uint32_t kMaxIndex = (1u << kIndexBits) - 1;
+	static const uint32_t kMaxGeneration = (1u << (32 - kIndexBits)) - 1;
+	
+	EntityHandle() : mValue(0) {}
+	EntityHandle(uint32_t lIndex, uint32_t lGeneration) : mValue((lGeneration << kIndexBits) | lIndex) {}
 	
-	virtual void update(float lTimeDeltaSec);
+	uint32_t index() const		{ return mValue & kMaxIndex; }
+	uint32_t generation() const	{ return mValue >> kIndexBits; }
+	bool isNull() const			{ return mValue == 0; }
+	
+	// The packed form, for snapshots
+	uint32_t value() const { return mValue; }
+	static EntityHandle fromValue(uint32_t lValue) { EntityHandle lHandle; lHandle.mValue = lValue; return lHandle; }
+	
+	bool operator==(EntityHandle lOther) const { return mValue == lOther.mValue; }
+	bool operator!=(EntityHandle lOther) const { return mValue != lOther.mValue; }
+	
+private:
+	uint32_t mValue;
+};
+
+//------------------------------------------------------------------------------
+
+// The data is kept in the world's component store (see components.h), and an entity is a view of its components
+class Entity
+{
+public:
+	Entity(World* lpWorld, float lX, float lY);
+	Entity(ComponentStore& lrComponents, float lX, float lY);		// for one outside any world, e.g. a temporary sprite
+	virtual ~Entity();
+	
+	// Each step, every entity's update() is called, then the components are updated as a batch (e.g. velocities are
+	// applied to positions), and then afterMove() is called.
+	virtual void update(float lTimeDeltaSec) {}
+	virtual void afterMove(float lTimeDeltaSec) {}
 	virtual void render() const {}
 	
-	virtual const char* type() const { return "entity"; }
+	static constexpr const char* kType = "entity";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
-	typedef Entity* (*FactoryFn)(const std::vector<std::string>& lrParameters);
+	// A factory creates an entity from string parameters.  A spawn function constructs one in the memory given, from
+	// packed float parameters, for spawning many at once.
+	typedef Entity* (*FactoryFn)(World* lpWorld, const std::vector<std::string>& lrParameters);
+	typedef Entity* (*SpawnFn)(World* lpWorld, void* lpMemory, const float* lpParameters);
 	
+	// The name and tags are indexed by the entity manager when the entity is registered, so set them before that.
+	// Registering also tags the entity with its type.
 	const std::string& name() const { return mName; }
 	void setName(const std::string& lrName) { mName = lrName; }
-	
-	float x() const { return mX; }
-	float y() const { return mY; }
-	void setX(float lX) { mX = lX; }
-	void setY(float lY) { mY = lY; }
-	void setPos(float lX, float lY) { mX = lX; mY = lY; }
-	
-	float velX() const { return mVelX; }
-	float velY() const { return mVelY; }
-	void setVelX(float lVelX) { mVelX = lVelX; }
-	void setVelY(float lVelY) { mVelY = lVelY; }
-	void setVel(float lVelX, float lVelY) { mVelX = lVelX; mVelY = lVelY; }
+	static const int kMaxTags = 4;
+	void addTag(Name lTag);
+	bool hasTag(Name lTag) const;
+	int numTags() const { return mNumTags; }
+	Name tag(int lIndex) const { return mTags[lIndex]; }
+	
+	float x() const { return transform().mX; }
+	float y() const { return transform().mY; }
+	void setX(float lX) { transform().mX = lX; }
+	void setY(float lY) { transform().mY = lY; }
+	void setPos(float lX, float lY) { Transform& lrTransform = transform(); lrTransform.mX = lX; lrTransform.mY = lY; }
+	
+	float velX() const { return transform().mVelX; }
+	float velY() const { return transform().mVelY; }
+	void setVelX(float lVelX) { transform().mVelX = lVelX; if (!mAwake && lVelX != 0.0f) wake(); }
+	void setVelY(float lVelY) { transform().mVelY = lVelY; if (!mAwake && lVelY != 0.0f) wake(); }
+	void setVel(float lVelX, float lVelY) { setVelX(lVelX); setVelY(lVelY); }
+	
+	// Static entities never move by themselves, and are never updated.  Sleepy ones are only updated while awake;
+	// they're woken by contact, by being given a velocity or by calling wake(), and fall asleep again after a step
+	// with nothing to do.  Either kind starts asleep, so set this before registering the entity.
+	enum Activity { kAlwaysActive, kSleepy, kStatic };
+	Activity activity() const { return mActivity; }
+	void setActivity(Activity lActivity) { mActivity = lActivity; }
+	bool isAwake() const { return mAwake; }
+	void wake();		// during the update, it's woken once all the entities have updated
+	
+	// For the entity manager.  Asleep, the entity's components are left out of the systems.  One that has just
+	// woken gets a full step before it can fall asleep again.
+	void setAwake(bool lAwake);
+	bool hasJustWoken() const { return mJustWoken; }
+	void clearJustWoken() { mJustWoken = false; }
+	virtual bool isIdle() const { return velX() == 0.0f && velY() == 0.0f; }
+	uint32_t serial() const { return mSerial; }		// goes up with each entity registered, so it orders them
+	void setSerial(uint32_t lSerial) { mSerial = lSerial; }
+	
+	// Time not yet passed to update() because the simulation LOD skipped it (see EntityManager::setLodFocus())
+	float lodSkippedSec() const { return mLodSkippedSec; }
+	void setLodSkippedSec(float lSec) { mLodSkippedSec = lSec; }
+	
+	// Rendering interpolates between the state saved at the start of the last simulation step and the current state
+	virtual void savePreviousState();
+	static void setRenderInterpolation(float lFactor) { msRenderInterp = lFactor; }
+	float renderX() const { const Transform& lrTransform = transform(); return lrTransform.mPrevX + (lrTransform.mX - lrTransform.mPrevX) * msRenderInterp; }
+	float renderY() const { const Transform& lrTransform = transform(); return lrTransform.mPrevY + (lrTransform.mY - lrTransform.mPrevY) * msRenderInterp; }
 	
 	void getSpeedAndDir(float* lpSpeedOut, float* lpDirRadOut) const;
 	float speed() const;
 	
-	float width() const			{ return mWidth; }
-	float height() const		{ return mHeight; }
-	float halfWidth() const		{ return mWidth * 0.5f; }
-	float halfHeight() const	{ return mHeight * 0.5f; }
+	float width() const			{ return transform().mWidth; }
+	float height() const		{ return transform().mHeight; }
+	float halfWidth() const		{ return transform().mWidth * 0.5f; }
+	float halfHeight() const	{ return transform().mHeight * 0.5f; }
 	
-	float left() const		{ return mX - mWidth * 0.5f; }
-	float right() const		{ return mX	+ mWidth * 0.5f; }
-	float top() const		{ return mY - mHeight * 0.5f; }
-	float bottom() const	{ return mY + mHeight * 0.5f; }
+	float left() const		{ const Transform& lrTransform = transform(); return lrTransform.mX - lrTransform.mWidth * 0.5f; }
+	float right() const		{ const Transform& lrTransform = transform(); return lrTransform.mX + lrTransform.mWidth * 0.5f; }
+	float top() const		{ const Transform& lrTransform = transform(); return lrTransform.mY - lrTransform.mHeight * 0.5f; }
+	float bottom() const	{ const Transform& lrTransform = transform(); return lrTransform.mY + lrTransform.mHeight * 0.5f; }
 	
 	bool isPointInRect(float lX, float lY) const { return lX >= left() && lX < right() && lY >= top() && lY < bottom(); }
 	
 	bool isAlive() const { return mAlive; }
-	void kill() { mAlive = false; }
+	void kill() { mAlive = false; }		// use EntityManager::kill(), which takes it out of the lists
+	
+	// The handle is set when the entity is registered with its world's entity manager.  The ID is its slot index,
+	// which is unique among the world's entities at any one time, but may be reused once the entity is reclaimed.
+	World* world() const { return mpWorld; }
+	EntityHandle handle() const { return mHandle; }
+	void setHandle(EntityHandle lHandle) { mHandle = lHandle; }
+	int id() const { return int(mHandle.index()); }
+	
+	// The pool the entity's memory came from, or null if it was allocated with new
+	EntityPool* pool() const { return mpPool; }
+	void setPool(EntityPool* lpPool) { mpPool = lpPool; }
 	
+	// Snapshots hold only what changes during the simulation, not anything fixed at construction.  Overrides must
+	// call the base class version first.
+	virtual void saveState(SnapshotWriter& lrWriter) const;
+	virtual void loadState(SnapshotReader& lrReader);
+	
+	// Just the state that matters to the outcome (transforms, velocities and alive flags), for spotting desyncs
+	virtual void addToHash(StateHash& lrHash) const;
 	
 protected:
 	
-	void setWidth(float lWidth)		{ mWidth = lWidth; }
-	void setHeight(float lHeight)	{ mHeight = lHeight; }
-	void setSize(float lWidth, float lHeight) { mWidth = lWidth; mHeight = lHeight; }
+	void setWidth(float lWidth)		{ transform().mWidth = lWidth; }
+	void setHeight(float lHeight)	{ transform().mHeight = lHeight; }
+	void setSize(float lWidth, float lHeight) { Transform& lrTransform = transform(); lrTransform.mWidth = lWidth; lrTransform.mHeight = lHeight; }
+	
+	// Moves the entity's components in or out of the ranges the systems run over.  Overrides must call the base
+	// class version.
+	virtual void setComponentsActive(bool lActive);
+	
+	ComponentStore& components() const { return *mpComponents; }
+	Transform& transform() { return mpComponents->transforms()[mTransformIndex]; }
+	const Transform& transform() const { return mpComponents->transforms()[mTransformIndex]; }
 	
-	float mX;
-	float mY;
-	float mVelX;
-	float mVelY;
+	static float msRenderInterp;	// [0, 1]: 0 for the previous step's state, 1 for the current state
 	
 private:
 	std::string mName;
-	float mWidth;
-	float mHeight;
+	Name mTags[kMaxTags];		// fixed, so tagging doesn't allocate
+	int mNumTags;
 	bool mAlive;
+	Activity mActivity;
+	bool mAwake;
+	bool mJustWoken;
+	uint32_t mSerial;
+	float mLodSkippedSec;
+	World* mpWorld;
+	ComponentStore* mpComponents;
+	EntityPool* mpPool;
+	int mTransformIndex;
+	EntityHandle mHandle;
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+// EntityCommandBuffer: Changes to the set of entities (spawning, killing and
+//                      waking) and to the world (collision events, sounds)
+//                      recorded during the update, and applied in one batch
+//                      once it's finished, so that nothing changes the entity
+//                      lists or the world while the entities are updating.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "entitycommands.h"
+
+#include "entitymanager.h"
+#include "spriteentity.h"
+#include "world.h"
+
+//------------------------------------------------------------------------------
+
+void EntityCommandBuffer::spawn(EntityTypeId lType, const float* lpParameters, size_t lNumParameters,
+								EntityHandle* lpHandleOut)
+{
+	Command lCommand = { kSpawn, EntityHandle(), lType, mParameters.size(), lNumParameters, lpHandleOut, Name(), 0 };
+	mCommands.push_back(lCommand);
+	mParameters.insert(mParameters.end(), lpParameters, lpParameters + lNumParameters);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityCommandBuffer::kill(EntityHandle lHandle)
+{
+	Command lCommand = { kKill, lHandle, 0, 0, 0, nullptr, Name(), 0 };
+	mCommands.push_back(lCommand);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityCommandBuffer::wake(EntityHandle lHandle)
+{
+	Command lCommand = { kWake, lHandle, 0, 0, 0, nullptr, Name(), 0 };
+	mCommands.push_back(lCommand);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityCommandBuffer::triggerCollisionEvent(EntityHandle lHandle)
+{
+	Command lCommand = { kCollisionEvent, lHandle, 0, 0, 0, nullptr, Name(), 0 };
+	mCommands.push_back(lCommand);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityCommandBuffer::playSound(Name lName, int lMaxNum)
+{
+	Command lCommand = { kSound, EntityHandle(), 0, 0, 0, nullptr, lName, lMaxNum };
+	mCommands.push_back(lCommand);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityCommandBuffer::apply(EntityManager& lrEntities)
+{
+	// By index and by value, as applying a command can record more
+	for (size_t lIndex = 0; lIndex < mCommands.size(); ++lIndex)
+	{
+		Command lCommand = mCommands[lIndex];
+		switch (lCommand.mType)
+		{
+			case kSpawn:
+				lrEntities.spawn(lCommand.mEntityType, mParameters.data() + lCommand.mFirstParameter,
+								 lCommand.mNumParameters, 1, lCommand.mpHandleOut);
+				break;
+			case kKill:
+			{
+				Entity* lpEntity = lrEntities.entity(lCommand.mHandle);
+				if (lpEntity != nullptr)
+					lrEntities.kill(lpEntity);
+				break;
+			}
+			case kWake:
+			{
+				Entity* lpEntity = lrEntities.entity(lCommand.mHandle);
+				if (lpEntity != nullptr)
+					lpEntity->wake();
+				break;
+			}
+			case kCollisionEvent:
+			{
+				CollidableEntity* lpEntity = lrEntities.entity<CollidableEntity>(lCommand.mHandle);
+				if (lpEntity != nullptr)
+					lpEntity->triggerCollisionEvent();
+				break;
+			}
+			case kSound:
+				lrEntities.world()->playSound(lCommand.mSoundName.str(), lCommand.mMaxSoundNum);
+				break;
+		}
+	}
+	mCommands.clear();
+	mParameters.clear();
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,63 @@
+//------------------------------------------------------------------------------
+// EntityCommandBuffer: Changes to the set of entities (spawning, killing and
+//                      waking) and to the world (collision events, sounds)
+//                      recorded during the update, and applied in one batch
+//                      once it's finished, so that nothing changes the entity
+//                      lists or the world while the entities are updating.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef ENTITYCOMMANDS_H
+#define ENTITYCOMMANDS_H
+
+#include "entity.h"
+
+#include <cstddef>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class EntityManager;
+
+//------------------------------------------------------------------------------
+
+// Each chunk of entities updated records into its own buffer.  The buffers are applied in the order the entities
+// would be updated on one thread, and each one in the order its commands were recorded, so the results don't depend
+// on the threads' timing.  Anything recorded while a buffer is being applied goes on the end of it.
+class EntityCommandBuffer
+{
+public:
+	// Spawns an entity with its type's spawn function (see EntityManager::spawn()), copying the parameters.  The new
+	// entity's handle is written to lpHandleOut, if given, when it's spawned.
+	void spawn(EntityTypeId lType, const float* lpParameters, size_t lNumParameters, EntityHandle* lpHandleOut = nullptr);
+	void kill(EntityHandle lHandle);
+	void wake(EntityHandle lHandle);
+	void triggerCollisionEvent(EntityHandle lHandle);		// see CollidableEntity
+	void playSound(Name lName, int lMaxNum);				// see World::playSound()
+	
+	bool isEmpty() const { return mCommands.empty(); }
+	void apply(EntityManager& lrEntities);		// then clears the buffer
+	
+private:
+	enum CommandType { kSpawn, kKill, kWake, kCollisionEvent, kSound };
+	struct Command
+	{
+		CommandType mType;
+		EntityHandle mHandle;			// to kill, wake or trigger
+		EntityTypeId mEntityType;		// to spawn
+		size_t mFirstParameter;			// in mParameters
+		size_t mNumParameters;
+		EntityHandle* mpHandleOut;
+		Name mSoundName;
+		int mMaxSoundNum;
+	};
+	
+	// Both keep their capacity from step to step, so recording doesn't usually allocate
+	std::vector<Command> mCommands;
+	std::vector<float> mParameters;		// for all the spawns, packed
+};
+
+//------------------------------------------------------------------------------
+
+#endif // ENTITYCOMMANDS_H
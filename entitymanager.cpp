@@ -7,15 +7,135 @@
 
 #include "entitymanager.h"
 
+#include "carentity.h"
+#include "houseentity.h"
+#include "jobsystem.h"
+#include "manentity.h"
+#include "playercarentity.h"
+#include "snapshot.h"
+#include "spriteentity.h"
+#include "settings.h"
 #include "useful.h"
+#include "world.h"
 
-#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <typeinfo>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	// The qualified calls need no virtual dispatch, as each list holds only the one exact type
+	template <typename Type> void afterMoveAll(const std::vector<Type*>& lrList, float lTimeDeltaSec)
+	{
+		for (Type* lpEntity: lrList)
+			lpEntity->Type::afterMove(lTimeDeltaSec);
+	}
+	
+	// The simulation LOD tiers, nearest first: beyond each distance, entities are updated once in so many steps
+	struct LodTier
+	{
+		float mDistanceSq;
+		uint32_t mStepInterval;
+	};
+	
+	std::vector<LodTier> loadLodTiers()
+	{
+		std::vector<float> lDistances = Settings::getFloatVector("lod/distances");
+		std::vector<int> lIntervals = Settings::getIntVector("lod/step_intervals");
+		ASSERT2(lDistances.size() == lIntervals.size(), "Each LOD distance needs a step interval");
+		std::vector<LodTier> lTiers;
+		for (size_t lIndex = 0; lIndex < min(lDistances.size(), lIntervals.size()); ++lIndex)
+		{
+			LodTier lTier = { lDistances[lIndex] * lDistances[lIndex], uint32_t(max(lIntervals[lIndex], 1)) };
+			lTiers.push_back(lTier);
+		}
+		return lTiers;
+	}
+	
+	// Whether the entity is due an update this step.  Its serial staggers the updates of the entities in each tier
+	// over the steps, rather than them all coming at once.
+	bool isDueUpdate(const Entity* lpEntity, float lFocusX, float lFocusY, uint32_t lStep)
+	{
+		static const std::vector<LodTier> kTiers = loadLodTiers();
+		
+		float lOffsetX = lpEntity->x() - lFocusX;
+		float lOffsetY = lpEntity->y() - lFocusY;
+		float lDistanceSq = lOffsetX * lOffsetX + lOffsetY * lOffsetY;
+		uint32_t lStepInterval = 1;
+		for (const LodTier& lrTier: kTiers)
+			if (lDistanceSq >= lrTier.mDistanceSq)
+				lStepInterval = lrTier.mStepInterval;
+		return (lStep + lpEntity->serial()) % lStepInterval == 0;
+	}
+	
+	// Grows the list geometrically, as reserving exactly what's needed each time would reallocate every time
+	template <typename Type> void reserveFor(std::vector<Type>& lrList, size_t lNumExtra)
+	{
+		size_t lNumNeeded = lrList.size() + lNumExtra;
+		if (lNumNeeded > lrList.capacity())
+			lrList.reserve(max(lNumNeeded, lrList.capacity() * 2));
+	}
+	
+	template <typename Type> void insertInOrder(std::vector<Type*>& lrList, Type* lpEntity)
+	{
+		// Usually it's the newest, and this is just an append
+		auto liPos = std::upper_bound(lrList.begin(), lrList.end(), lpEntity,
+									  [](const Type* lpA, const Type* lpB) { return lpA->serial() < lpB->serial(); });
+		lrList.insert(liPos, lpEntity);
+	}
+	
+	// A sleepy entity that's had nothing to do since the start of the last step (so it's where it was then) goes to
+	// sleep.  This is after the previous states are saved, so it won't be interpolated while asleep.
+	bool fallAsleepIfIdle(Entity* lpEntity)
+	{
+		if (lpEntity->activity() != Entity::kSleepy)
+			return false;
+		if (lpEntity->hasJustWoken())
+		{
+			lpEntity->clearJustWoken();
+			return false;
+		}
+		if (!lpEntity->isIdle() || lpEntity->lodSkippedSec() > 0.0f)
+			return false;
+		lpEntity->setAwake(false);
+		return true;
+	}
+	
+	template <typename Type> void putIdleToSleep(std::vector<Type*>& lrList)
+	{
+		lrList.erase(std::remove_if(lrList.begin(), lrList.end(), fallAsleepIfIdle), lrList.end());
+	}
+	
+	template <typename Type> void removeInOrder(std::vector<Type*>& lrList, Type* lpEntity)
+	{
+		// The lists are all in serial order, so the entity can be found by a binary search
+		auto liPos = std::lower_bound(lrList.begin(), lrList.end(), lpEntity,
+									  [](const Type* lpA, const Type* lpB) { return lpA->serial() < lpB->serial(); });
+		if (liPos != lrList.end() && *liPos == lpEntity)
+			lrList.erase(liPos);
+	}
+}
 
 //------------------------------------------------------------------------------
 // EntityManager
 //------------------------------------------------------------------------------
 
-EntityManager::EntityManager()
+thread_local EntityCommandBuffer* EntityManager::mspThreadCommands = nullptr;
+
+//------------------------------------------------------------------------------
+
+EntityManager::EntityManager(World* lpWorld) :
+	mpWorld(lpWorld),
+	mCommandBuffers(1),
+	mNumCommandBuffersUsed(0),
+	mUpdateInParallel(false),
+	mLodFocusX(0.0f),
+	mLodFocusY(0.0f),
+	mUpdating(false),
+	mNextSerial(0),
+	mLoggingEnabled(true)
 {
 }
 
@@ -28,54 +148,546 @@ EntityManager::~EntityManager()
 
 //------------------------------------------------------------------------------
 
-EntityManager& EntityManager::instance()
+EntityManager::FactoryMap& EntityManager::factories()
 {
-	static EntityManager sInstance;
-	return sInstance;
+	static FactoryMap sFactories;
+	return sFactories;
 }
 
 //------------------------------------------------------------------------------
 
 void EntityManager::registerFactory(const std::string &lrType, Entity::FactoryFn lpFactoryFunc)
 {
-	mFactories[lrType] = lpFactoryFunc;
-	printf("Registered factory for \"%s\"\n", lrType.c_str());
+	registerFactory(lrType.c_str(), lpFactoryFunc, nullptr, 0, nullptr);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::registerFactory(const char* lpType, Entity::FactoryFn lpFactoryFunc, Entity::SpawnFn lpSpawnFunc,
+									size_t lObjectSize, const std::type_info* lpTypeInfo)
+{
+	Factory& lrFactory = factories()[entityTypeId(lpType)];
+	ASSERT2(lrFactory.mType.empty() || lrFactory.mType == lpType, "Two factory names have the same type ID");
+	lrFactory.mType = lpType;
+	lrFactory.mpCreateFunc = lpFactoryFunc;
+	lrFactory.mpSpawnFunc = lpSpawnFunc;
+	lrFactory.mObjectSize = lObjectSize;
+	lrFactory.mpTypeInfo = lpTypeInfo;
+	printf("Registered factory for \"%s\"\n", lpType);
 }
 
 //------------------------------------------------------------------------------
 
 void EntityManager::registerEntity(Entity *lpNewEntity)
 {
-	mEntities.push_back(lpNewEntity);
+	addEntity(lpNewEntity);
+	if (mLoggingEnabled)
+		printf("Registered entity \"%s\" at (%.1f, %.1f)\n", lpNewEntity->name().c_str(), lpNewEntity->x(), lpNewEntity->y());
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::addEntity(Entity* lpNewEntity)
+{
+	ASSERT(lpNewEntity->world() == mpWorld);
+	ASSERT2(!mUpdating, "Entities registered during the update must go through the command buffer");
+	lpNewEntity->addTag(Name(lpNewEntity->type()));
 	if (lpNewEntity->name().empty())
 		setNameForEntity(lpNewEntity);
 	
-	printf("Registered entity \"%s\" at (%.1f, %.1f)\n", lpNewEntity->name().c_str(), lpNewEntity->x(), lpNewEntity->y());
+	uint32_t lIndex;
+	if (!mFreeSlots.empty())
+	{
+		lIndex = mFreeSlots.back();
+		mFreeSlots.pop_back();
+	}
+	else
+	{
+		lIndex = uint32_t(mSlots.size());
+		ASSERT(lIndex <= EntityHandle::kMaxIndex);
+		Slot lNewSlot = { nullptr, 0, Name() };
+		mSlots.push_back(lNewSlot);
+	}
+	
+	// A new generation makes any handles to the slot's last entity stale
+	Slot& lrSlot = mSlots[lIndex];
+	lrSlot.mGeneration = lrSlot.mGeneration < EntityHandle::kMaxGeneration ? lrSlot.mGeneration + 1 : 1;
+	lrSlot.mpEntity = lpNewEntity;
+	lpNewEntity->setHandle(EntityHandle(lIndex, lrSlot.mGeneration));
+	lpNewEntity->setSerial(mNextSerial++);
+	if (lpNewEntity->activity() != Entity::kAlwaysActive)
+		lpNewEntity->setAwake(false);
+	
+	lpNewEntity->savePreviousState();	// it may have been moved since construction; don't interpolate from there
+	mEntities.push_back(lpNewEntity);
+	addToTypeLists(lpNewEntity);
+	lrSlot.mName = Name(lpNewEntity->name());
+	addToIndex(lpNewEntity);
 }
 
 //------------------------------------------------------------------------------
 
 void EntityManager::setNameForEntity(Entity *lpEntity)
 {
-	const char* lpType = lpEntity->type();
-	std::ostringstream lOutStr;
-	lOutStr << lpType << " " << mEntities.size();
-	std::string lName = lOutStr.str();
+	// Short names fit in the string without a heap allocation
+	char lName[64];
+	snprintf(lName, sizeof(lName), "%s %u", lpEntity->type(), unsigned(mEntities.size()));
 	lpEntity->setName(lName);
 }
 
 //------------------------------------------------------------------------------
 
+void EntityManager::addToTypeLists(Entity* lpEntity)
+{
+	if (lpEntity->isAwake())
+		addToUpdateList(lpEntity);
+	
+	// Only once per entity, so the cast is cheap enough here
+	CollidableEntity* lpCollidable = dynamic_cast<CollidableEntity*>(lpEntity);
+	if (lpCollidable != nullptr)
+		mCollidables.push_back(lpCollidable);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::addToUpdateList(Entity* lpEntity)
+{
+	// The exact type is checked, as a subclass may override update()
+	const std::type_info& lrType = typeid(*lpEntity);
+	if (lrType == typeid(SpriteEntity))
+		insertInOrder(mSprites, static_cast<SpriteEntity*>(lpEntity));
+	else if (lrType == typeid(HouseEntity))
+		insertInOrder(mHouses, static_cast<HouseEntity*>(lpEntity));
+	else if (lrType == typeid(ManEntity))
+		insertInOrder(mMen, static_cast<ManEntity*>(lpEntity));
+	else if (lrType == typeid(TargetEntity))
+		insertInOrder(mTargets, static_cast<TargetEntity*>(lpEntity));
+	else if (lrType == typeid(CarEntity))
+		insertInOrder(mCars, static_cast<CarEntity*>(lpEntity));
+	else if (lrType == typeid(PlayerCarEntity))
+		insertInOrder(mPlayerCars, static_cast<PlayerCarEntity*>(lpEntity));
+	else
+		insertInOrder(mOtherEntities, lpEntity);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::removeFromTypeLists(Entity* lpEntity)
+{
+	// As in addToUpdateList(); if it's asleep, it isn't in any of these
+	const std::type_info& lrType = typeid(*lpEntity);
+	if (lrType == typeid(SpriteEntity))
+		removeInOrder(mSprites, static_cast<SpriteEntity*>(lpEntity));
+	else if (lrType == typeid(HouseEntity))
+		removeInOrder(mHouses, static_cast<HouseEntity*>(lpEntity));
+	else if (lrType == typeid(ManEntity))
+		removeInOrder(mMen, static_cast<ManEntity*>(lpEntity));
+	else if (lrType == typeid(TargetEntity))
+		removeInOrder(mTargets, static_cast<TargetEntity*>(lpEntity));
+	else if (lrType == typeid(CarEntity))
+		removeInOrder(mCars, static_cast<CarEntity*>(lpEntity));
+	else if (lrType == typeid(PlayerCarEntity))
+		removeInOrder(mPlayerCars, static_cast<PlayerCarEntity*>(lpEntity));
+	else
+		removeInOrder(mOtherEntities, lpEntity);
+	
+	CollidableEntity* lpCollidable = dynamic_cast<CollidableEntity*>(lpEntity);
+	if (lpCollidable != nullptr)
+		removeInOrder(mCollidables, lpCollidable);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::clearTypeLists()
+{
+	mSprites.clear();
+	mHouses.clear();
+	mMen.clear();
+	mTargets.clear();
+	mCars.clear();
+	mPlayerCars.clear();
+	mOtherEntities.clear();
+	mCollidables.clear();
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::putIdleToSleep()
+{
+	::putIdleToSleep(mSprites);
+	::putIdleToSleep(mHouses);
+	::putIdleToSleep(mMen);
+	::putIdleToSleep(mTargets);
+	::putIdleToSleep(mCars);
+	::putIdleToSleep(mPlayerCars);
+	::putIdleToSleep(mOtherEntities);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::wake(Entity* lpEntity)
+{
+	if (mUpdating)
+	{
+		commands().wake(lpEntity->handle());
+		return;
+	}
+	if (lpEntity->isAwake() || !lpEntity->isAlive())
+		return;
+	lpEntity->setAwake(true);
+	addToUpdateList(lpEntity);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::kill(Entity* lpEntity)
+{
+	if (mUpdating)
+	{
+		commands().kill(lpEntity->handle());
+		return;
+	}
+	if (!lpEntity->isAlive())
+		return;
+	lpEntity->kill();
+	mKilledEntities.push_back(lpEntity);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::addToIndex(Entity* lpEntity)
+{
+	EntityHandle lHandle = lpEntity->handle();
+	uint32_t lNameIndex = mSlots[lHandle.index()].mName.index();
+	if (lNameIndex >= mHandlesByName.size())
+		mHandlesByName.resize(lNameIndex + 1);
+	mHandlesByName[lNameIndex] = lHandle;
+	
+	for (int lTagIndex = 0; lTagIndex < lpEntity->numTags(); ++lTagIndex)
+	{
+		uint32_t lTag = lpEntity->tag(lTagIndex).index();
+		if (lTag >= mHandlesByTag.size())
+			mHandlesByTag.resize(lTag + 1);
+		mHandlesByTag[lTag].push_back(lHandle);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::removeFromIndex(Entity* lpEntity)
+{
+	EntityHandle lHandle = lpEntity->handle();
+	uint32_t lNameIndex = mSlots[lHandle.index()].mName.index();
+	if (mHandlesByName[lNameIndex] == lHandle)
+		mHandlesByName[lNameIndex] = EntityHandle();
+	
+	for (int lTagIndex = 0; lTagIndex < lpEntity->numTags(); ++lTagIndex)
+	{
+		std::vector<EntityHandle>& lrHandles = mHandlesByTag[lpEntity->tag(lTagIndex).index()];
+		lrHandles.erase(std::find(lrHandles.begin(), lrHandles.end(), lHandle));
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::clearIndex()
+{
+	std::fill(mHandlesByName.begin(), mHandlesByName.end(), EntityHandle());
+	for (std::vector<EntityHandle>& lrHandles: mHandlesByTag)
+		lrHandles.clear();
+}
+
+//------------------------------------------------------------------------------
+
+Entity* EntityManager::findByName(Name lName) const
+{
+	if (lName.index() >= mHandlesByName.size())
+		return nullptr;
+	Entity* lpEntity = entity(mHandlesByName[lName.index()]);
+	return lpEntity != nullptr && lpEntity->isAlive() ? lpEntity : nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+const std::vector<EntityHandle>& EntityManager::findByTag(Name lTag) const
+{
+	static const std::vector<EntityHandle> kNone;
+	return lTag.index() < mHandlesByTag.size() ? mHandlesByTag[lTag.index()] : kNone;
+}
+
+//------------------------------------------------------------------------------
+
 void EntityManager::update(float lTimeDeltaSec)
 {
-	// Remove dead entities first
-	std::vector<Entity*>::iterator liEraseBegin = std::partition(mEntities.begin(), mEntities.end(),
-																 [](Entity* lpEntity) { return lpEntity->isAlive(); });
-	mEntities.erase(liEraseBegin, mEntities.end());
+	// Remove the entities that died during the last step first, keeping the order of the rest (for rendering and
+	// collisions).  Only those are looked for, so nothing is done on the usual step where nothing died.  They're
+	// taken in list order, so their slots are freed in the same order however they were killed.
+	std::sort(mKilledEntities.begin(), mKilledEntities.end(),
+			  [](const Entity* lpA, const Entity* lpB) { return lpA->serial() < lpB->serial(); });
+	for (Entity* lpEntity: mKilledEntities)
+	{
+		mDeadEntities.push_back(std::make_pair(lpEntity->handle(), mpWorld->numSteps() - 1));
+		removeFromIndex(lpEntity);
+		removeInOrder(mEntities, lpEntity);
+		removeFromTypeLists(lpEntity);
+	}
+	mKilledEntities.clear();
 	
-	// Update all
-	for (Entity* lpEntity: mEntities)
-		lpEntity->update(lTimeDeltaSec);
+	// Keep the previous state for render interpolation.  Sleeping entities don't move, so they don't need it.
+	mComponents.savePreviousStates();
+	putIdleToSleep();
+	
+	// Each entity's own behaviour.  Cars go last, so that they collide with everything else as it is after this step.
+	// The lists can't change until the commands recorded meanwhile are applied.  Big lists are split into chunks that
+	// update in parallel, one list after another.
+	mUpdating = true;
+	mNumCommandBuffersUsed = 0;
+	float lUpdateSec;
+	updateList(mSprites, lTimeDeltaSec);
+	updateList(mHouses, lTimeDeltaSec);
+	updateList(mMen, lTimeDeltaSec);
+	updateList(mTargets, lTimeDeltaSec);
+	mspThreadCommands = &mCommandBuffers[takeCommandBuffers(1)];		// other types might not be safe to split up
+	for (Entity* lpEntity: mOtherEntities)
+		if (updateDue(lpEntity, lTimeDeltaSec, &lUpdateSec))
+			lpEntity->update(lUpdateSec);
+	mspThreadCommands = nullptr;
+	updateList(mCars, lTimeDeltaSec);
+	updateList(mPlayerCars, lTimeDeltaSec);
+	mUpdating = false;
+	applyCommands();
+	
+	// Then everything awake (including anything just woken) moves at once, and anything constrained is fixed up (only
+	// cars and other types need this)
+	mComponents.integrate(lTimeDeltaSec);
+	for (Entity* lpEntity: mOtherEntities)
+		lpEntity->afterMove(lTimeDeltaSec);
+	afterMoveAll(mCars, lTimeDeltaSec);
+	afterMoveAll(mPlayerCars, lTimeDeltaSec);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::reclaimDead(uint32_t lOldestSnapshotStep)
+{
+	size_t lNumKept = 0;
+	for (const std::pair<EntityHandle, uint32_t>& lrDead: mDeadEntities)
+	{
+		if (lrDead.second >= lOldestSnapshotStep)
+		{
+			mDeadEntities[lNumKept++] = lrDead;
+			continue;
+		}
+		destroyEntity(entity(lrDead.first));
+		freeSlot(lrDead.first.index());
+	}
+	mDeadEntities.resize(lNumKept);
+}
+
+//------------------------------------------------------------------------------
+
+size_t EntityManager::numPooledEntities() const
+{
+	size_t lNumEntities = 0;
+	for (const auto& lrPool: mPools)
+		lNumEntities += lrPool.second->numAllocated();
+	return lNumEntities;
+}
+
+//------------------------------------------------------------------------------
+
+EntityPool* EntityManager::pool(const std::type_index& lrType, size_t lObjectSize)
+{
+	EntityPool*& lrpPool = mPools[lrType];
+	if (lrpPool == nullptr)
+		lrpPool = new EntityPool(lObjectSize);
+	return lrpPool;
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::destroyEntity(Entity* lpEntity)
+{
+	EntityPool* lpPool = lpEntity->pool();
+	if (lpPool == nullptr)
+	{
+		delete lpEntity;
+		return;
+	}
+	
+	void* lpMemory = dynamic_cast<void*>(lpEntity);		// the start of the whole object
+	lpEntity->~Entity();
+	lpPool->release(lpMemory);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::freeSlot(uint32_t lIndex)
+{
+	mSlots[lIndex].mpEntity = nullptr;
+	mFreeSlots.push_back(lIndex);
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::saveState(SnapshotWriter& lrWriter) const
+{
+	for (const EntityCommandBuffer& lrBuffer: mCommandBuffers)
+		ASSERT(lrBuffer.isEmpty());		// commands are only pending during the update
+	
+	// The slots' generations and the free list, so that handles stay valid and are given out the same way
+	lrWriter.write(uint32_t(mSlots.size()));
+	for (const Slot& lrSlot: mSlots)
+		lrWriter.write(lrSlot.mGeneration);
+	lrWriter.write(uint32_t(mFreeSlots.size()));
+	for (uint32_t lIndex: mFreeSlots)
+		lrWriter.write(lIndex);
+	
+	lrWriter.write(uint32_t(mEntities.size()));
+	for (const Entity* lpEntity: mEntities)
+	{
+		lrWriter.write(uint32_t(lpEntity->id()));
+		lpEntity->saveState(lrWriter);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+bool EntityManager::loadState(SnapshotReader& lrReader)
+{
+	uint32_t lNumSlots;
+	lrReader.read(&lNumSlots);
+	if (lrReader.failed() || lNumSlots > mSlots.size())
+		return false;
+	
+	// Anything in a slot that's been reused (or added) since the snapshot can't be in it.  Slots whose entities have
+	// been reclaimed since just stay empty.
+	for (uint32_t lIndex = 0; lIndex < mSlots.size(); ++lIndex)
+	{
+		Slot& lrSlot = mSlots[lIndex];
+		uint32_t lGeneration = 0;
+		if (lIndex < lNumSlots)
+			lrReader.read(&lGeneration);
+		if (lrSlot.mGeneration == lGeneration)
+			continue;
+		if (lrSlot.mpEntity != nullptr)
+			destroyEntity(lrSlot.mpEntity);
+		lrSlot.mpEntity = nullptr;
+		lrSlot.mGeneration = lGeneration;
+	}
+	mSlots.resize(lNumSlots);
+	
+	uint32_t lNumFreeSlots;
+	lrReader.read(&lNumFreeSlots);
+	if (lrReader.failed() || lNumFreeSlots > lNumSlots)
+		return false;
+	mFreeSlots.resize(lNumFreeSlots);
+	for (uint32_t& lrIndex: mFreeSlots)
+	{
+		lrReader.read(&lrIndex);
+		if (lrReader.failed() || lrIndex >= lNumSlots || mSlots[lrIndex].mpEntity != nullptr)
+			return false;
+	}
+	// Slots emptied since the snapshot go after the ones it had free.  This is rare, so a search is fine.
+	for (uint32_t lIndex = 0; lIndex < lNumSlots; ++lIndex)
+		if (mSlots[lIndex].mpEntity == nullptr && std::find(mFreeSlots.begin(), mFreeSlots.end(), lIndex) == mFreeSlots.end())
+			mFreeSlots.push_back(lIndex);
+	
+	uint32_t lNumEntities;
+	lrReader.read(&lNumEntities);
+	mEntities.clear();
+	mKilledEntities.clear();
+	clearTypeLists();
+	clearIndex();
+	for (uint32_t lEntityIndex = 0; lEntityIndex < lNumEntities; ++lEntityIndex)
+	{
+		uint32_t lIndex;
+		lrReader.read(&lIndex);
+		if (lrReader.failed() || lIndex >= lNumSlots || mSlots[lIndex].mpEntity == nullptr)
+			return false;
+		Entity* lpEntity = mSlots[lIndex].mpEntity;
+		lpEntity->loadState(lrReader);
+		mEntities.push_back(lpEntity);
+		addToTypeLists(lpEntity);
+		addToIndex(lpEntity);
+		if (!lpEntity->isAlive())
+			mKilledEntities.push_back(lpEntity);		// it died in the snapshot's last step
+	}
+	
+	// Forget the dead entities that have been destroyed, or are back in the lists; the latter are removed again next
+	// step, as above
+	mDeadEntities.erase(std::remove_if(mDeadEntities.begin(), mDeadEntities.end(),
+									   [this](const std::pair<EntityHandle, uint32_t>& lrDead)
+									   {
+										   Entity* lpEntity = entity(lrDead.first);
+										   return lpEntity == nullptr || std::find(mEntities.begin(), mEntities.end(), lpEntity) != mEntities.end();
+									   }),
+						mDeadEntities.end());
+	return !lrReader.failed();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename Type> void EntityManager::updateList(const std::vector<Type*>& lrList, float lTimeDeltaSec)
+{
+	static const size_t kChunkSize = size_t(max(Settings::getInt("simulation/update_chunk_size"), 1));
+	
+	// The chunks' buffers are numbered in list order, whichever threads the chunks run on
+	size_t lNumChunks = mUpdateInParallel ? max((lrList.size() + kChunkSize - 1) / kChunkSize, size_t(1)) : 1;
+	size_t lFirstBuffer = takeCommandBuffers(lNumChunks);
+	auto lUpdateChunk = [this, &lrList, lTimeDeltaSec, lNumChunks, lFirstBuffer](size_t lChunk, size_t)
+	{
+		mspThreadCommands = &mCommandBuffers[lFirstBuffer + lChunk];
+		size_t lEnd = lrList.size() * (lChunk + 1) / lNumChunks;
+		float lUpdateSec;
+		for (size_t lIndex = lrList.size() * lChunk / lNumChunks; lIndex < lEnd; ++lIndex)
+			if (updateDue(lrList[lIndex], lTimeDeltaSec, &lUpdateSec))
+				lrList[lIndex]->Type::update(lUpdateSec);		// qualified, as the list holds only the one exact type
+		mspThreadCommands = nullptr;
+	};
+	if (lNumChunks == 1)
+		lUpdateChunk(0, 1);
+	else
+		gJobSystem.parallelFor(0, lNumChunks, 1, lUpdateChunk);
+}
+
+//------------------------------------------------------------------------------
+
+bool EntityManager::updateDue(Entity* lpEntity, float lTimeDeltaSec, float* lpUpdateSecOut) const
+{
+	if (!isDueUpdate(lpEntity, mLodFocusX, mLodFocusY, mpWorld->numSteps()))
+	{
+		lpEntity->setLodSkippedSec(lpEntity->lodSkippedSec() + lTimeDeltaSec);
+		return false;
+	}
+	*lpUpdateSecOut = lTimeDeltaSec + lpEntity->lodSkippedSec();
+	lpEntity->setLodSkippedSec(0.0f);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+size_t EntityManager::takeCommandBuffers(size_t lNumBuffers)
+{
+	// Grown before any chunk runs, as the threads hold pointers into it
+	size_t lFirst = mNumCommandBuffersUsed;
+	mNumCommandBuffersUsed += lNumBuffers;
+	if (mCommandBuffers.size() < mNumCommandBuffersUsed)
+		mCommandBuffers.resize(mNumCommandBuffersUsed);
+	return lFirst;
+}
+
+//------------------------------------------------------------------------------
+
+void EntityManager::applyCommands()
+{
+	// Anything recorded while applying a buffer goes on the end of it
+	for (EntityCommandBuffer& lrBuffer: mCommandBuffers)
+	{
+		mspThreadCommands = &lrBuffer;
+		lrBuffer.apply(*this);
+	}
+	mspThreadCommands = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -108,23 +720,83 @@ Entity* EntityManager::create(const std::string& lrType, const std::string& lrPa
 
 Entity* EntityManager::create(const std::string& lrType, const std::vector<std::string>& lrParameters)
 {
-	// Find the right factory
-	auto liFactory = mFactories.find(lrType);
-	if (liFactory == mFactories.end())
+	EntityTypeId lType = entityTypeId(lrType.c_str());
+	if (factories().find(lType) == factories().end())
 	{
 		printf("Factory for \"%s\" not found.\n", lrType.c_str());
 		return nullptr;
 	}
+	return create(lType, lrParameters);
+}
+
+//------------------------------------------------------------------------------
+
+Entity* EntityManager::create(EntityTypeId lType, const std::vector<std::string>& lrParameters)
+{
+	// Find the right factory
+	auto liFactory = factories().find(lType);
+	if (liFactory == factories().end())
+	{
+		printf("Factory for type %08x not found.\n", unsigned(lType));
+		return nullptr;
+	}
+	const Factory& lrFactory = liFactory->second;
+	
+	// Without a create function, spawn just the one
+	if (lrFactory.mpCreateFunc == nullptr)
+	{
+		const size_t kMaxParameters = 16;
+		float lParameters[kMaxParameters] = {};
+		for (size_t lIndex = 0; lIndex < lrParameters.size() && lIndex < kMaxParameters; ++lIndex)
+			lParameters[lIndex] = getFloatParam(lrParameters, int(lIndex));
+		EntityHandle lHandle;
+		spawn(lType, lParameters, kMaxParameters, 1, &lHandle);
+		return entity(lHandle);
+	}
 	
 	// Create the entity
-	Entity::FactoryFn lpFactoryFunc = liFactory->second;
-	Entity* lpNewEntity = lpFactoryFunc(lrParameters);
+	Entity* lpNewEntity = lrFactory.mpCreateFunc(mpWorld, lrParameters);
 	registerEntity(lpNewEntity);
 	return lpNewEntity;
 }
 
 //------------------------------------------------------------------------------
 
+size_t EntityManager::spawn(EntityTypeId lType, const float* lpParameters, size_t lParamsPerEntity, size_t lCount,
+							EntityHandle* lpHandlesOut)
+{
+	auto liFactory = factories().find(lType);
+	if (liFactory == factories().end() || liFactory->second.mpSpawnFunc == nullptr)
+	{
+		printf("No spawn function for entity type %08x.\n", unsigned(lType));
+		return 0;
+	}
+	const Factory& lrFactory = liFactory->second;
+	
+	// Make room for them all first, so that nothing grows part of the way through
+	EntityPool* lpPool = pool(*lrFactory.mpTypeInfo, lrFactory.mObjectSize);
+	lpPool->reserve(lCount);
+	reserveFor(mEntities, lCount);
+	reserveFor(mSlots, lCount > mFreeSlots.size() ? lCount - mFreeSlots.size() : 0);
+	
+	for (size_t lIndex = 0; lIndex < lCount; ++lIndex)
+	{
+		Entity* lpNewEntity = lrFactory.mpSpawnFunc(mpWorld, lpPool->allocate(), lpParameters + lIndex * lParamsPerEntity);
+		lpNewEntity->setPool(lpPool);
+		addEntity(lpNewEntity);
+		if (lpHandlesOut != nullptr)
+			lpHandlesOut[lIndex] = lpNewEntity->handle();
+	}
+	
+	if (mLoggingEnabled && lCount == 1)
+		printf("Registered entity \"%s\" at (%.1f, %.1f)\n", mEntities.back()->name().c_str(), mEntities.back()->x(), mEntities.back()->y());
+	else if (mLoggingEnabled)
+		printf("Spawned %u entities with \"%s\"\n", unsigned(lCount), lrFactory.mType.c_str());
+	return lCount;
+}
+
+//------------------------------------------------------------------------------
+
 void EntityManager::init()
 {
 }
@@ -133,9 +805,21 @@ void EntityManager::init()
 
 void EntityManager::shutDown()
 {
-	for (Entity* lpEntity: mEntities)
-		delete lpEntity;
+	for (const Slot& lrSlot: mSlots)
+		if (lrSlot.mpEntity != nullptr)
+			destroyEntity(lrSlot.mpEntity);
 	mEntities.clear();
+	mSlots.clear();
+	mFreeSlots.clear();
+	mDeadEntities.clear();
+	mKilledEntities.clear();
+	clearTypeLists();
+	mHandlesByName.clear();
+	mHandlesByTag.clear();
+	
+	for (auto& lrPool: mPools)
+		delete lrPool.second;
+	mPools.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -144,14 +828,22 @@ void EntityManager::shutDown()
 
 EntityFactory::EntityFactory(const std::string& lrType, Entity::FactoryFn pFunc)
 {
-	EntityManager::instance().registerFactory(lrType, pFunc);
+	EntityManager::registerFactory(lrType, pFunc);
+}
+
+//------------------------------------------------------------------------------
+
+EntityFactory::EntityFactory(const char* lpType, Entity::FactoryFn lpFunc, Entity::SpawnFn lpSpawnFunc, size_t lObjectSize,
+							 const std::type_info& lrTypeInfo)
+{
+	EntityManager::registerFactory(lpType, lpFunc, lpSpawnFunc, lObjectSize, &lrTypeInfo);
 }
 
 //------------------------------------------------------------------------------
 
-Entity* createTestEntity(const std::vector<std::string>& lrParams)
+Entity* createTestEntity(World* lpWorld, const std::vector<std::string>& lrParams)
 {
-	return new Entity(getFloatParam(lrParams, 0), getFloatParam(lrParams, 1));
+	return new Entity(lpWorld, getFloatParam(lrParams, 0), getFloatParam(lrParams, 1));
 }
 
 EntityFactory sTestFactory("test", &createTestEntity);
@@ -9,54 +9,227 @@
 #define ENTITYMANAGER_H
 
 #include "entity.h"
+#include "entitycommands.h"
+#include "entitypool.h"
 
+#include <cstdint>
+#include <new>
 #include <string>
+#include <typeindex>
+#include <typeinfo>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 //------------------------------------------------------------------------------
 
+class CarEntity;
+class CollidableEntity;
+class HouseEntity;
+class ManEntity;
+class PlayerCarEntity;
+class SpriteEntity;
+class TargetEntity;
+
+//------------------------------------------------------------------------------
+
 // Construct a new EntityFactory object anywhere in global scope to register a
 // type of entity along with a function to create it
 struct EntityFactory
 {
 	EntityFactory(const std::string& lrType, Entity::FactoryFn pFunc);
+	
+protected:
+	EntityFactory(const char* lpType, Entity::FactoryFn lpFunc, Entity::SpawnFn lpSpawnFunc, size_t lObjectSize,
+				  const std::type_info& lrTypeInfo);
+};
+
+// Or this one, for a type that can be spawned in bulk.  The create function may be null, in which case creating one
+// spawns it with the string parameters converted to floats.
+template <typename Type> struct SpawnableEntityFactory : public EntityFactory
+{
+	SpawnableEntityFactory(const char* lpType, Entity::FactoryFn lpFunc, Entity::SpawnFn lpSpawnFunc) :
+		EntityFactory(lpType, lpFunc, lpSpawnFunc, sizeof(Type), typeid(Type)) {}
 };
 
 //------------------------------------------------------------------------------
 
+// Each world has its own entity manager.  The factories are shared between them.
 class EntityManager
 {
 public:
-	EntityManager();
+	EntityManager(World* lpWorld);
 	~EntityManager();
 	
-	static EntityManager& instance();
-	
 	void init();
 	void shutDown();
 	
-	void registerFactory(const std::string& lrType, Entity::FactoryFn lpFactoryFunc);
+	// Factories are keyed by the type ID of their names (see entityTypeId()).  A spawn function is optional; the
+	// size and type are those of the entities it constructs.
+	static void registerFactory(const std::string& lrType, Entity::FactoryFn lpFactoryFunc);
+	static void registerFactory(const char* lpType, Entity::FactoryFn lpFactoryFunc, Entity::SpawnFn lpSpawnFunc,
+								size_t lObjectSize, const std::type_info* lpTypeInfo);
 	void registerEntity(Entity* lpNewEntity);	// only call this when creating entities outside EntityManager::create()
 	
-	void setNameForEntity(Entity* lpEntity);	// sets a default name; call after registering
+	// Entities can't be registered or killed during the update, or change anything outside themselves; they record
+	// those changes here instead, and they're applied once all the entities have updated.  Each chunk of entities
+	// updated has its own buffer.  Commands recorded outside the update are applied after the next one.
+	EntityCommandBuffer& commands() { return mspThreadCommands != nullptr ? *mspThreadCommands : mCommandBuffers[0]; }
+	bool isUpdating() const { return mUpdating; }
+	
+	// In parallel, lists of entities big enough to split into chunks (see "simulation/update_chunk_size") are updated
+	// by the job system's threads.  With the changes deferred as above, the results are the same as on one thread.
+	void setUpdateInParallel(bool lInParallel) { mUpdateInParallel = lInParallel; }
+	
+	// The simulation level of detail.  Entities far from the focus (the player) are updated less often, as set by the
+	// "lod" settings, and the time skipped is added to their next update.  Velocities are still applied every step.
+	void setLodFocus(float lX, float lY) { mLodFocusX = lX; mLodFocusY = lY; }
+	
+	// Constructs an entity in this world, in memory from its type's pool rather than the heap.  Register it once it's
+	// set up.
+	template <typename Type, typename... Args> Type* newEntity(Args... lArgs)
+	{
+		EntityPool* lpPool = pool(typeid(Type), sizeof(Type));
+		Type* lpEntity = new (lpPool->allocate()) Type(mpWorld, lArgs...);
+		lpEntity->setPool(lpPool);
+		return lpEntity;
+	}
+	
+	// Destroys the entities that died before the step of the oldest snapshot kept; any older snapshot would still have
+	// them in it.  Called at the end of each step.
+	void reclaimDead(uint32_t lOldestSnapshotStep);
+	size_t numPooledEntities() const;		// allocated from the pools, whether alive or dead
+	
+	// The data of all the world's entities, including ones not yet registered (and the camera)
+	ComponentStore& components() { return mComponents; }
 	
 	Entity* create(const std::string& lrParameterString);
 	Entity* create(const std::string& lrType, const std::string& lrParameterString);
 	Entity* create(const std::string& lrType, const std::vector<std::string>& lrParameters);
+	Entity* create(EntityTypeId lType, const std::vector<std::string>& lrParameters);
+	
+	// Creates lCount entities of a type with a spawn function.  Each takes lParamsPerEntity floats from lpParameters,
+	// packed one after another.  Their memory is reserved in one go, and they're registered in one pass.  Their handles
+	// are written to lpHandlesOut if it isn't null.  Returns the number spawned, which is 0 if there's no spawn function.
+	size_t spawn(EntityTypeId lType, const float* lpParameters, size_t lParamsPerEntity, size_t lCount,
+				 EntityHandle* lpHandlesOut = nullptr);
+	
+	const std::vector<Entity*>& allEntities() const { return mEntities; }		// just the live ones, in render order
 	
-	const std::vector<Entity*>& allEntities() const { return mEntities; }
+	// The live collidable entities, awake or not, in registration order.  This is kept up to date as entities are
+	// registered and die, so it costs nothing to query.
+	const std::vector<CollidableEntity*>& collidables() const { return mCollidables; }
+	
+	// Puts a sleeping entity back in the update (see Entity::Activity).  During the update, this is recorded as a
+	// command instead.
+	void wake(Entity* lpEntity);
+	
+	// Kills an entity, which is taken out of the lists at the start of the next update.  During the update, this is
+	// recorded as a command instead.
+	void kill(Entity* lpEntity);
+	
+	// Null for a null or stale handle; the entity may be dead, but not yet reclaimed
+	Entity* entity(EntityHandle lHandle) const
+	{
+		uint32_t lIndex = lHandle.index();
+		if (lIndex >= mSlots.size() || mSlots[lIndex].mGeneration != lHandle.generation())
+			return nullptr;
+		return mSlots[lIndex].mpEntity;
+	}
+	template <typename Type> Type* entity(EntityHandle lHandle) const { return static_cast<Type*>(entity(lHandle)); }
+	
+	// Lookups by name or tag are an array index, without allocating.  They only find live entities (though a tag's
+	// list may have ones killed during this step).  If two live entities share a name, the later one is found.
+	Entity* findByName(Name lName) const;
+	template <typename Type> Type* findByName(Name lName) const { return static_cast<Type*>(findByName(lName)); }
+	const std::vector<EntityHandle>& findByTag(Name lTag) const;		// in registration order
 	
 	void update(float lTimeDeltaSec);
 	void render() const;
 	
+	World* world() const { return mpWorld; }
+	
+	void setLoggingEnabled(bool lEnabled) { mLoggingEnabled = lEnabled; }
+	
+	// Entities registered since the snapshot was saved are destroyed on loading, and dead ones it has are revived.
+	// Handles saved with the snapshot resolve to the same entities after loading it.
+	void saveState(SnapshotWriter& lrWriter) const;
+	bool loadState(SnapshotReader& lrReader);		// returns false if the snapshot doesn't match this world
+	
 private:
+	struct Factory
+	{
+		std::string mType;
+		Entity::FactoryFn mpCreateFunc;
+		Entity::SpawnFn mpSpawnFunc;
+		size_t mObjectSize;
+		const std::type_info* mpTypeInfo;
+	};
+	typedef std::unordered_map<EntityTypeId, Factory> FactoryMap;
+	static FactoryMap& factories();		// function-local, as factories are registered during static initialisation
+	
+	void setNameForEntity(Entity* lpEntity);	// a default name, for entities registered without one
+	void addEntity(Entity* lpNewEntity);		// registers it, without logging
+	void addToTypeLists(Entity* lpEntity);
+	void addToUpdateList(Entity* lpEntity);		// in registration order
+	void removeFromTypeLists(Entity* lpEntity);
+	void clearTypeLists();
+	void putIdleToSleep();
+	void addToIndex(Entity* lpEntity);
+	void removeFromIndex(Entity* lpEntity);
+	void clearIndex();
+	EntityPool* pool(const std::type_index& lrType, size_t lObjectSize);
+	void destroyEntity(Entity* lpEntity);		// returns it to its pool, if it came from one
+	void freeSlot(uint32_t lIndex);
+	
+	template <typename Type> void updateList(const std::vector<Type*>& lrList, float lTimeDeltaSec);
+	bool updateDue(Entity* lpEntity, float lTimeDeltaSec, float* lpUpdateSecOut) const;	// see setLodFocus()
+	size_t takeCommandBuffers(size_t lNumBuffers);		// returns the index of the first
+	void applyCommands();
+	
+	World* mpWorld;
+	ComponentStore mComponents;
+	std::vector<EntityCommandBuffer> mCommandBuffers;
+	size_t mNumCommandBuffersUsed;						// this update, in order
+	static thread_local EntityCommandBuffer* mspThreadCommands;	// for the chunk being updated or applied on the thread
+	bool mUpdateInParallel;
+	float mLodFocusX, mLodFocusY;
+	bool mUpdating;
+	uint32_t mNextSerial;
 	std::vector<Entity*> mEntities;
-	std::unordered_map<std::string, Entity::FactoryFn> mFactories;
+	
+	// Entities of these exact types are updated a list at a time with direct calls, rather than a virtual call each.
+	// Anything else (including any subclasses of these) goes in mOtherEntities and is updated virtually.  These are
+	// just views of the components, which the bulk of the work goes through.  Only awake entities are in these, so
+	// the cost of the update goes with the number awake, not the number there are.
+	std::vector<SpriteEntity*> mSprites;
+	std::vector<HouseEntity*> mHouses;
+	std::vector<ManEntity*> mMen;
+	std::vector<TargetEntity*> mTargets;
+	std::vector<CarEntity*> mCars;
+	std::vector<PlayerCarEntity*> mPlayerCars;
+	std::vector<Entity*> mOtherEntities;
+	std::vector<CollidableEntity*> mCollidables;		// all types, for collision checks
+	
+	// Every entity registered and not yet reclaimed has a slot.  Free slots are reused last-freed first.
+	struct Slot
+	{
+		Entity* mpEntity;		// null if free
+		uint32_t mGeneration;	// of the current or last entity in the slot
+		Name mName;				// of the entity, interned when it was registered
+	};
+	std::vector<Slot> mSlots;
+	std::vector<uint32_t> mFreeSlots;
+	std::vector<Entity*> mKilledEntities;		// killed since the last update, which takes them out of the lists
+	std::vector<std::pair<EntityHandle, uint32_t>> mDeadEntities;	// dead but not yet reclaimed, with the step they died in
+	std::unordered_map<std::type_index, EntityPool*> mPools;
+	
+	// Indexed by the names' indices.  The tags' lists keep their capacity as entities come and go.
+	std::vector<EntityHandle> mHandlesByName;
+	std::vector<std::vector<EntityHandle>> mHandlesByTag;
+	bool mLoggingEnabled;
 };
 
-#define gEntityManager EntityManager::instance()
-
 //------------------------------------------------------------------------------
 
 #endif // ENTITYMANAGER_H
@@ -0,0 +1,86 @@
+//------------------------------------------------------------------------------
+// EntityPool: Memory for entities of one type, recycled through a free list so
+//             that spawning and destroying entities doesn't touch the heap once
+//             the pool has grown to the most that have been alive at once.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "entitypool.h"
+
+#include "useful.h"
+
+#include <cstddef>
+#include <new>
+
+//------------------------------------------------------------------------------
+
+EntityPool::EntityPool(size_t lObjectSize) :
+	mpFreeList(nullptr),
+	mNumAllocated(0),
+	mCapacity(0)
+{
+	// Keep every object in a chunk aligned as well as the chunk itself
+	const size_t kAlign = alignof(std::max_align_t);
+	mObjectSize = (max(lObjectSize, sizeof(FreeObject)) + kAlign - 1) / kAlign * kAlign;
+}
+
+//------------------------------------------------------------------------------
+
+EntityPool::~EntityPool()
+{
+	ASSERT(mNumAllocated == 0);
+	for (void* lpChunk: mChunks)
+		::operator delete(lpChunk);
+}
+
+//------------------------------------------------------------------------------
+
+void* EntityPool::allocate()
+{
+	if (mpFreeList == nullptr)
+		addChunk(kObjectsPerChunk);
+	
+	FreeObject* lpObject = mpFreeList;
+	mpFreeList = lpObject->mpNext;
+	++mNumAllocated;
+	return lpObject;
+}
+
+//------------------------------------------------------------------------------
+
+void EntityPool::release(void* lpObject)
+{
+	ASSERT(mNumAllocated > 0);
+	FreeObject* lpFreeObject = static_cast<FreeObject*>(lpObject);
+	lpFreeObject->mpNext = mpFreeList;
+	mpFreeList = lpFreeObject;
+	--mNumAllocated;
+}
+
+//------------------------------------------------------------------------------
+
+void EntityPool::reserve(size_t lNumObjects)
+{
+	size_t lNumFree = mCapacity - mNumAllocated;
+	if (lNumObjects > lNumFree)
+		addChunk(max(lNumObjects - lNumFree, kObjectsPerChunk));
+}
+
+//------------------------------------------------------------------------------
+
+void EntityPool::addChunk(size_t lNumObjects)
+{
+	// Thread all the chunk's objects onto the free list in order
+	char* lpChunk = static_cast<char*>(::operator new(mObjectSize * lNumObjects));
+	mChunks.push_back(lpChunk);
+	for (size_t lIndex = lNumObjects; lIndex-- > 0;)
+	{
+		FreeObject* lpObject = reinterpret_cast<FreeObject*>(lpChunk + lIndex * mObjectSize);
+		lpObject->mpNext = mpFreeList;
+		mpFreeList = lpObject;
+	}
+	mCapacity += lNumObjects;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+// EntityPool: Memory for entities of one type, recycled through a free list so
+//             that spawning and destroying entities doesn't touch the heap once
+//             the pool has grown to the most that have been alive at once.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef ENTITYPOOL_H
+#define ENTITYPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class EntityPool
+{
+public:
+	EntityPool(size_t lObjectSize);
+	~EntityPool();		// only frees the memory; the entities must have been destroyed already
+	
+	void* allocate();
+	void release(void* lpObject);
+	void reserve(size_t lNumObjects);		// makes sure that many can be allocated, adding at most one chunk
+	
+	size_t numAllocated() const { return mNumAllocated; }
+	size_t capacity() const { return mCapacity; }
+	
+private:
+	static const size_t kObjectsPerChunk = 16;
+	
+	struct FreeObject { FreeObject* mpNext; };		// kept in the free objects' own memory
+	
+	void addChunk(size_t lNumObjects);
+	
+	size_t mObjectSize;
+	std::vector<void*> mChunks;
+	FreeObject* mpFreeList;
+	size_t mNumAllocated;
+	size_t mCapacity;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // ENTITYPOOL_H
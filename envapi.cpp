@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------
+// envapi: A C interface for stepping many games at once from outside, e.g. to
+//         train or test automated drivers.  Each game drives the player's car
+//         with analogue controls and reports observations as plain floats.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "envapi.h"
+
+#include "jobsystem.h"
+#include "platform.h"
+#include "settings.h"
+#include "texturemanager.h"
+#include "useful.h"
+#include "worldbatch.h"
+
+#include <mutex>
+
+//------------------------------------------------------------------------------
+
+struct Env
+{
+	Env(int lNumWorlds, uint32_t lBaseSeed, int lNumThreads) : mBatch(lNumWorlds, lBaseSeed, lNumThreads) {}
+	
+	WorldBatch mBatch;
+};
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	// The same as headless mode: textures are loaded for their sizes, but there's no window, GL, audio or fonts.  The
+	// job system is shared with the application when it's there to start it.
+	void initSharedAssets()
+	{
+		static std::once_flag sInitFlag;
+		std::call_once(sInitFlag, []()
+		{
+			if (!gJobSystem.isRunning())
+				gJobSystem.init(Platform::numWorkerThreads());
+			Settings::load();
+			TextureManager::initDecoding();
+			gTextureManager.init(TextureManager::DoNotUseGL);
+		});
+	}
+}
+
+//------------------------------------------------------------------------------
+
+extern "C"
+{
+	Env* env_create(int lNumWorlds, uint32_t lBaseSeed, int lNumThreads)
+	{
+		if (lNumWorlds <= 0)
+			return nullptr;
+		initSharedAssets();
+		return new Env(lNumWorlds, lBaseSeed, lNumThreads);
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	void env_destroy(Env* lpEnv)
+	{
+		delete lpEnv;
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	int env_numWorlds(const Env* lpEnv)
+	{
+		return lpEnv->mBatch.numWorlds();
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	int env_numThreads(const Env* lpEnv)
+	{
+		return lpEnv->mBatch.numThreads();
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	void env_reset(Env* lpEnv, int lWorldIndex, uint32_t lSeed, float* lpObsOut)
+	{
+		lpEnv->mBatch.resetWorld(lWorldIndex, lSeed);
+		if (lpObsOut != nullptr)
+			lpEnv->mBatch.observeWorld(lWorldIndex, lpObsOut);
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	void env_observe(const Env* lpEnv, float* lpObsOut)
+	{
+		lpEnv->mBatch.observe(lpObsOut);
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	void env_step(Env* lpEnv, const float* lpControls, int lNumSteps, float* lpObsOut)
+	{
+		ASSERT(lpControls != nullptr);
+		lpEnv->mBatch.step(lpControls, max(lNumSteps, 0), lpObsOut);
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	double env_stepsPerSecPerCore(const Env* lpEnv)
+	{
+		return lpEnv->mBatch.stepsPerSecPerThread();
+	}
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------
+// envapi: A C interface for stepping many games at once from outside, e.g. to
+//         train or test automated drivers.  Each game drives the player's car
+//         with analogue controls and reports observations as plain floats.
+//
+// Games run on a fixed step, as in the game itself, and the data directory
+// must be reachable from the working directory, as for the executable.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef ENVAPI_H
+#define ENVAPI_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//------------------------------------------------------------------------------
+
+typedef struct Env Env;		// opaque
+
+// Layout of the observations for one game.  Games are packed one after another, so game N starts at
+// N * kEnvObsSize.
+enum EnvObservation
+{
+	kEnvObsX,
+	kEnvObsY,
+	kEnvObsVelX,
+	kEnvObsVelY,
+	kEnvObsRotationRad,
+	kEnvObsCountdownSec,		// time left to deliver the passenger; zero without one
+	kEnvObsHaveTarget,			// 1 with a passenger, otherwise 0
+	kEnvObsTargetX,				//
+	kEnvObsTargetY,				// the drop-off point, or zero without a passenger
+	kEnvObsCash,
+	
+	kEnvObsSize
+};
+
+// Layout of the controls for one game, also packed one game after another
+enum EnvControl
+{
+	kEnvControlAccel,			// >0 => accelerate; <0 => brake/reverse accelerate
+	kEnvControlSteer,			// <0 => left; >0 => right
+	
+	kEnvNumControls
+};
+
+// Creates lNumWorlds games, seeded lBaseSeed, lBaseSeed + 1, etc., shared between up to lNumThreads threads (zero or
+// less for one per core).  The threads are the process's shared job system's, started with the first games and
+// running until the process exits.  Returns null on failure.
+Env* env_create(int lNumWorlds, uint32_t lBaseSeed, int lNumThreads);
+void env_destroy(Env* lpEnv);
+
+int env_numWorlds(const Env* lpEnv);
+int env_numThreads(const Env* lpEnv);
+
+// Starts one game again from scratch with a new seed, and writes its kEnvObsSize observations
+void env_reset(Env* lpEnv, int lWorldIndex, uint32_t lSeed, float* lpObsOut);
+
+// Writes the observations for all games: env_numWorlds() * kEnvObsSize floats
+void env_observe(const Env* lpEnv, float* lpObsOut);
+
+// Applies env_numWorlds() * kEnvNumControls controls, each clamped to [-1, 1], and holds them for lNumSteps steps of
+// every game.  The observations are then written as for env_observe(), directly from the worker threads.  Nothing
+// is allocated.
+void env_step(Env* lpEnv, const float* lpControls, int lNumSteps, float* lpObsOut);
+
+// Game steps per second of wall time spent in env_step(), divided by the number of threads
+double env_stepsPerSecPerCore(const Env* lpEnv);
+
+//------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENVAPI_H
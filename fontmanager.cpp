@@ -6,6 +6,7 @@
 
 #include "fontmanager.h"
 
+#include "platform.h"
 #include "settings.h"
 #include "spriteentity.h"
 #include "texturemanager.h"
@@ -33,12 +34,10 @@ FontManager::~FontManager()
 
 //------------------------------------------------------------------------------
 
-bool FontManager::init(SDL_Surface* lpDisplaySurface)
+bool FontManager::init()
 {
 	ASSERT(!mInitialised);
 	
-	mpDisplaySurface = lpDisplaySurface;
-	
 	if (TTF_Init() < 0)
 	{
 		printf("TTF initialisation failed\n");
@@ -53,7 +52,7 @@ bool FontManager::init(SDL_Surface* lpDisplaySurface)
 		printf("Invalid default font\n");
 		return false;
 	}
-	mpDefaultFont = TTF_OpenFont(lDefaultFontFace.c_str(), lDefaultPointSize);
+	mpDefaultFont = TTF_OpenFont(Platform::getFontFileName(lDefaultFontFace).c_str(), lDefaultPointSize);
 	if (mpDefaultFont == nullptr)
 	{
 		printf("Error loading default font\n");
@@ -68,7 +67,8 @@ bool FontManager::init(SDL_Surface* lpDisplaySurface)
 
 void FontManager::shutDown()
 {
-	ASSERT(mInitialised);
+	if (!mInitialised)
+		return;
 	
 	TTF_CloseFont(mpDefaultFont);
 	mpDefaultFont = nullptr;
@@ -85,21 +85,20 @@ void FontManager::renderOnScreen(const char *lpText, float lX, float lY, SDL_Col
 	if (lY < 0.0f)
 		lY += Settings::getFloat("screen/height");
 	
-	const bool kBehindCamera = true;
-	renderInternal(lpText, lX, lY, lCol, lXAlign, lYAlign, kBehindCamera);
+	renderInternal(lpText, lX, lY, lCol, lXAlign, lYAlign, nullptr);
 }
 
 //------------------------------------------------------------------------------
 
-void FontManager::renderInWorld(const char *lpText, float lX, float lY, SDL_Color lCol)
+void FontManager::renderInWorld(const char *lpText, float lX, float lY, SDL_Color lCol, const Camera& lrCamera)
 {
-	const bool kNotBehindCamera = false;
-	renderInternal(lpText, lX, lY, lCol, kAlignXCentre, kAlignYCentre, kNotBehindCamera);
+	renderInternal(lpText, lX, lY, lCol, kAlignXCentre, kAlignYCentre, &lrCamera);
 }
 
 //------------------------------------------------------------------------------
 
-void FontManager::renderInternal(const char* lpText, float lX, float lY, SDL_Colour lCol, XAlignment lXAlign, YAlignment lYAlign, bool lBehindCamera)
+void FontManager::renderInternal(const char* lpText, float lX, float lY, SDL_Colour lCol, XAlignment lXAlign, YAlignment lYAlign,
+								 const Camera* lpCamera)
 {
 	ASSERT(mInitialised);
 	
@@ -121,10 +120,10 @@ void FontManager::renderInternal(const char* lpText, float lX, float lY, SDL_Col
 		lY += float(lpRenderedFontSurface->h) * 0.5f;
 	
 	// Create a temporary sprite and render it
-	SpriteEntity lTempSprite(lX, lY);
+	SpriteEntity lTempSprite(mSpriteComponents, lX, lY);
 	lTempSprite.setTexture(&lTex);
-	lTempSprite.setBehindCamera(lBehindCamera);
-	lTempSprite.render();
+	lTempSprite.setBehindCamera(lpCamera == nullptr);
+	lTempSprite.render(lpCamera);
 }
 
 //------------------------------------------------------------------------------
@@ -7,11 +7,13 @@
 #ifndef FONTS_H
 #define FONTS_H
 
+#include "components.h"
+
 #include <SDL/SDL_ttf.h>
 
 //------------------------------------------------------------------------------
 
-struct SDL_Surface;
+class Camera;
 
 //------------------------------------------------------------------------------
 
@@ -21,14 +23,14 @@ public:
 	FontManager();
 	~FontManager();
 	
-	bool init(SDL_Surface* lpDisplaySurface);
+	bool init();
 	void shutDown();
 	
 	enum XAlignment { kAlignLeft, kAlignXCentre, kAlignRight };
 	enum YAlignment { kAlignTop, kAlignYCentre, kAlignBottom };
 	
 	// This text is affected by camera movement
-	void renderInWorld(const char* lpText, float lX, float lY, SDL_Colour lCol);
+	void renderInWorld(const char* lpText, float lX, float lY, SDL_Colour lCol, const Camera& lrCamera);
 	
 	// This text is unaffected by camera movement.  You can also specify negative x and y to give positions relative to
 	// the right and bottom of the screen respectively.
@@ -36,11 +38,12 @@ public:
 	
 private:
 	
-	void renderInternal(const char* lpText, float lX, float lY, SDL_Colour lCol, XAlignment lXAlign, YAlignment lYAlign, bool lBehindCamera);
+	void renderInternal(const char* lpText, float lX, float lY, SDL_Colour lCol, XAlignment lXAlign, YAlignment lYAlign,
+						const Camera* lpCamera);	// null for text behind the camera
 	
 	bool			mInitialised;
 	TTF_Font*		mpDefaultFont;
-	SDL_Surface*	mpDisplaySurface;
+	ComponentStore	mSpriteComponents;		// for the temporary sprites that text is rendered with
 };
 
 extern FontManager gFontManager;
@@ -0,0 +1,98 @@
+//------------------------------------------------------------------------------
+// FrameScheduler: Paces the main loop at a target frame rate, dropping to a
+//                 low rate while the game is idle or hidden, and measures how
+//                 much CPU time each frame uses.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "framescheduler.h"
+
+#include "platform.h"
+#include "useful.h"
+
+//------------------------------------------------------------------------------
+
+FrameScheduler::FrameScheduler() :
+	mTargetFPS(0.0f),
+	mIdleFPS(0.0f),
+	mStatsIntervalSec(1.0f),
+	mIdle(false),
+	mRateChanged(false),
+	mNextDeadlineMS(0.0),
+	mFrameStartCPUMS(0.0),
+	mStatsStartMS(0.0),
+	mStatsCPUMS(0.0),
+	mStatsNumFrames(0),
+	mCPUMSPerFrame(0.0f),
+	mCPUFraction(0.0f)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void FrameScheduler::init(float lTargetFPS, float lIdleFPS, float lStatsIntervalSec)
+{
+	mTargetFPS = max(lTargetFPS, 0.0f);
+	mIdleFPS = max(lIdleFPS, 0.0f);
+	mStatsIntervalSec = max(lStatsIntervalSec, 0.1f);
+	mIdle = false;
+	mRateChanged = true;	// applied at the end of the first frame, once the main loop exists
+	
+	mNextDeadlineMS = Platform::getTimeMS();
+	mStatsStartMS = mNextDeadlineMS;
+}
+
+//------------------------------------------------------------------------------
+
+void FrameScheduler::beginFrame()
+{
+	mFrameStartCPUMS = Platform::getThreadCPUTimeMS();
+}
+
+//------------------------------------------------------------------------------
+
+void FrameScheduler::endFrame(bool lIdle)
+{
+	double lNowMS = Platform::getTimeMS();
+	
+	// Statistics
+	mStatsCPUMS += Platform::getThreadCPUTimeMS() - mFrameStartCPUMS;
+	++mStatsNumFrames;
+	double lStatsElapsedMS = lNowMS - mStatsStartMS;
+	if (lStatsElapsedMS >= mStatsIntervalSec * 1000.0f)
+	{
+		mCPUMSPerFrame = float(mStatsCPUMS / double(mStatsNumFrames));
+		mCPUFraction = float(mStatsCPUMS / lStatsElapsedMS);
+		mStatsCPUMS = 0.0;
+		mStatsNumFrames = 0;
+		mStatsStartMS = lNowMS;
+	}
+	
+	// Switch rates if needed.  The browser does its own waiting, so it has to be told the new rate.
+	if (lIdle != mIdle)
+	{
+		mIdle = lIdle;
+		mNextDeadlineMS = lNowMS;
+		mRateChanged = true;
+	}
+	if (mRateChanged)
+	{
+		Platform::setMainLoopRate(currentFPS());
+		mRateChanged = false;
+	}
+	
+	float lFPS = currentFPS();
+	if (lFPS <= 0.0f || !Platform::canSleep())
+		return;
+	
+	// Keep to a fixed cadence rather than a fixed gap after each frame, so the frame rate doesn't drift with the
+	// work done.  If we've fallen more than a frame behind, start afresh rather than rushing to catch up.
+	double lPeriodMS = 1000.0 / double(lFPS);
+	mNextDeadlineMS += lPeriodMS;
+	if (mNextDeadlineMS < lNowMS - lPeriodMS)
+		mNextDeadlineMS = lNowMS;
+	Platform::sleepUntil(mNextDeadlineMS, !mIdle);		// at the idle rate, a late frame doesn't matter; power does
+}
+
+//------------------------------------------------------------------------------
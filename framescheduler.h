@@ -0,0 +1,52 @@
+//------------------------------------------------------------------------------
+// FrameScheduler: Paces the main loop at a target frame rate, dropping to a
+//                 low rate while the game is idle or hidden, and measures how
+//                 much CPU time each frame uses.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+//------------------------------------------------------------------------------
+
+class FrameScheduler
+{
+public:
+	FrameScheduler();
+	
+	// A target rate of zero leaves pacing to the display (vsync or the browser)
+	void init(float lTargetFPS, float lIdleFPS, float lStatsIntervalSec);
+	
+	void beginFrame();
+	void endFrame(bool lIdle);		// waits until the next frame is due, where the platform allows it
+	
+	bool isIdle() const { return mIdle; }
+	
+	// The main thread's CPU time (not the workers'), averaged over the stats interval
+	float cpuMSPerFrame() const { return mCPUMSPerFrame; }
+	float cpuFraction() const { return mCPUFraction; }		// CPU time as a fraction of the elapsed time
+	
+private:
+	float currentFPS() const { return mIdle ? mIdleFPS : mTargetFPS; }
+	
+	float mTargetFPS;
+	float mIdleFPS;
+	float mStatsIntervalSec;
+	bool mIdle;
+	bool mRateChanged;		// the platform needs to be told the new rate
+	
+	double mNextDeadlineMS;
+	double mFrameStartCPUMS;
+	
+	double mStatsStartMS;
+	double mStatsCPUMS;
+	int mStatsNumFrames;
+	float mCPUMSPerFrame;
+	float mCPUFraction;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // FRAMESCHEDULER_H
@@ -11,9 +11,10 @@
 
 //------------------------------------------------------------------------------
 
-HouseEntity::HouseEntity(float lX, float lY) :
-	CollidableEntity(lX, lY)
+HouseEntity::HouseEntity(World* lpWorld, float lX, float lY) :
+	CollidableEntity(lpWorld, lX, lY)
 {
+	setActivity(kStatic);
 }
 
 //------------------------------------------------------------------------------
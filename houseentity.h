@@ -14,9 +14,12 @@
 class HouseEntity : public CollidableEntity
 {
 public:
-	HouseEntity(float lX, float lY);
+	HouseEntity(World* lpWorld, float lX, float lY);
 	
-	virtual const char* type() const { return "house"; }
+	static constexpr const char* kType = "house";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	virtual float bounceFactor() const;
 	
@@ -0,0 +1,211 @@
+//------------------------------------------------------------------------------
+// InitGraph: Runs start-up tasks in dependency order, running independent
+//            tasks at the same time on the job system's threads where the
+//            platform has them, and reports how long each one took.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "initgraph.h"
+
+#include "platform.h"
+#include "useful.h"
+#include <cstdio>
+
+//------------------------------------------------------------------------------
+
+InitGraph::InitGraph() :
+	mNumRunning(0),
+	mNumJobsWaiting(0),
+	mFailed(false),
+	mAllowMainThreadForAny(true),
+	mStartMS(0.0),
+	mEndMS(0.0),
+	mNumThreads(1)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void InitGraph::addTask(const std::string& lrName, ThreadAffinity lAffinity,
+						const std::vector<std::string>& lrDependencies, TaskFn lFunc)
+{
+	ASSERT2(findTask(lrName) < 0, lrName.c_str());
+	
+	Task lTask;
+	lTask.mName = lrName;
+	lTask.mAffinity = lAffinity;
+	lTask.mFunc = lFunc;
+	lTask.mNumUnmetDependencies = int(lrDependencies.size());
+	lTask.mpGraph = this;
+	lTask.mStartMS = 0.0;
+	lTask.mEndMS = 0.0;
+	lTask.mThreadIndex = -1;
+	lTask.mSucceeded = false;
+	
+	int lNewIndex = int(mTasks.size());
+	for (const std::string& lrDependency: lrDependencies)
+	{
+		int lDependencyIndex = findTask(lrDependency);
+		ASSERT2(lDependencyIndex >= 0, lrDependency.c_str());
+		mTasks[lDependencyIndex].mDependents.push_back(lNewIndex);
+	}
+	
+	mTasks.push_back(lTask);
+}
+
+//------------------------------------------------------------------------------
+
+bool InitGraph::run()
+{
+	mStartMS = Platform::getTimeMS();
+	mNumThreads = gJobSystem.numThreads();
+	mAllowMainThreadForAny = (mNumThreads == 1);
+	
+	// The main thread takes the main-thread tasks, and any others too if it's on its own
+	{
+		std::unique_lock<std::mutex> lLock(mMutex);
+		for (int li = 0; li < int(mTasks.size()); ++li)
+			if (mTasks[li].mNumUnmetDependencies == 0)
+				makeReady(li);
+		
+		while (!isFinished())
+		{
+			if (!mFailed && !mReadyMainTasks.empty())
+			{
+				int lTaskIndex = mReadyMainTasks.front();
+				mReadyMainTasks.pop_front();
+				runTask(lTaskIndex, 0, lLock);
+			}
+			else if (!mFailed && mAllowMainThreadForAny && !mReadyAnyTasks.empty())
+			{
+				int lTaskIndex = mReadyAnyTasks.front();
+				mReadyAnyTasks.pop_front();
+				runTask(lTaskIndex, 0, lLock);
+			}
+			else
+				mStateChanged.wait(lLock);
+		}
+	}
+	
+	// The last job may still be on its way out
+	gJobSystem.wait(mJobs);
+	
+	mEndMS = Platform::getTimeMS();
+	return !mFailed;
+}
+
+//------------------------------------------------------------------------------
+
+void InitGraph::printReport() const
+{
+	double lTotalTaskMS = 0.0;
+	for (const Task& lrTask: mTasks)
+		lTotalTaskMS += lrTask.mEndMS - lrTask.mStartMS;
+	
+	printf("Start-up tasks took %.1f ms on %d thread%s (%.1f ms of work):\n", mEndMS - mStartMS, mNumThreads,
+		   mNumThreads == 1 ? "" : "s", lTotalTaskMS);
+	for (const Task& lrTask: mTasks)
+	{
+		if (lrTask.mThreadIndex < 0)
+		{
+			printf("    %-24s not run\n", lrTask.mName.c_str());
+			continue;
+		}
+		
+		char lThreadName[24];
+		if (lrTask.mThreadIndex == 0)
+			snprintf(lThreadName, sizeof(lThreadName), "main");
+		else
+			snprintf(lThreadName, sizeof(lThreadName), "worker %d", lrTask.mThreadIndex);
+		printf("    %-24s %7.1f ms -> %7.1f ms  (%6.1f ms)  %s%s\n", lrTask.mName.c_str(),
+			   lrTask.mStartMS - mStartMS, lrTask.mEndMS - mStartMS, lrTask.mEndMS - lrTask.mStartMS, lThreadName,
+			   lrTask.mSucceeded ? "" : "  FAILED");
+	}
+}
+
+//------------------------------------------------------------------------------
+
+int InitGraph::findTask(const std::string& lrName) const
+{
+	for (int li = 0; li < int(mTasks.size()); ++li)
+		if (mTasks[li].mName == lrName)
+			return li;
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+
+void InitGraph::makeReady(int lTaskIndex)
+{
+	// Called with the lock held, so the job can't start until the caller lets go of it
+	if (mTasks[lTaskIndex].mAffinity == kMainThread)
+		mReadyMainTasks.push_back(lTaskIndex);
+	else if (mAllowMainThreadForAny)
+		mReadyAnyTasks.push_back(lTaskIndex);
+	else
+	{
+		++mNumJobsWaiting;
+		gJobSystem.add(&InitGraph::runTaskJob, &mTasks[lTaskIndex], &mJobs);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+bool InitGraph::isFinished() const
+{
+	if (mNumRunning > 0 || mNumJobsWaiting > 0)
+		return false;
+	return mFailed || (mReadyMainTasks.empty() && mReadyAnyTasks.empty());
+}
+
+//------------------------------------------------------------------------------
+
+void InitGraph::runTask(int lTaskIndex, int lThreadIndex, std::unique_lock<std::mutex>& lrLock)
+{
+	// Called with the lock held; it's released while the task itself runs
+	Task& lrTask = mTasks[lTaskIndex];
+	++mNumRunning;
+	lrLock.unlock();
+	
+	double lStartMS = Platform::getTimeMS();
+	bool lSucceeded = lrTask.mFunc();
+	double lEndMS = Platform::getTimeMS();
+	
+	lrLock.lock();
+	--mNumRunning;
+	lrTask.mStartMS = lStartMS;
+	lrTask.mEndMS = lEndMS;
+	lrTask.mThreadIndex = lThreadIndex;
+	lrTask.mSucceeded = lSucceeded;
+	
+	if (lSucceeded)
+	{
+		for (int lDependentIndex: lrTask.mDependents)
+			if (--mTasks[lDependentIndex].mNumUnmetDependencies == 0)
+				makeReady(lDependentIndex);
+	}
+	else
+	{
+		printf("Start-up task \"%s\" failed\n", lrTask.mName.c_str());
+		mFailed = true;
+	}
+	
+	mStateChanged.notify_all();
+}
+
+//------------------------------------------------------------------------------
+
+void InitGraph::runTaskJob(void* lpTask)
+{
+	Task& lrTask = *static_cast<Task*>(lpTask);
+	InitGraph& lrGraph = *lrTask.mpGraph;
+	std::unique_lock<std::mutex> lLock(lrGraph.mMutex);
+	--lrGraph.mNumJobsWaiting;
+	if (!lrGraph.mFailed)
+		lrGraph.runTask(int(&lrTask - &lrGraph.mTasks[0]), JobSystem::threadIndex(), lLock);
+	else
+		lrGraph.mStateChanged.notify_all();
+}
+
+//------------------------------------------------------------------------------
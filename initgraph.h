@@ -0,0 +1,87 @@
+//------------------------------------------------------------------------------
+// InitGraph: Runs start-up tasks in dependency order, running independent
+//            tasks at the same time on the job system's threads where the
+//            platform has them, and reports how long each one took.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef INITGRAPH_H
+#define INITGRAPH_H
+
+#include "jobsystem.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class InitGraph
+{
+public:
+	InitGraph();
+	
+	// Anything touching the window or GL has to stay on the main thread
+	enum ThreadAffinity { kMainThread, kAnyThread };
+	
+	// Tasks return false on failure, which stops any further tasks from starting.  Dependencies are given by name and
+	// must already have been added, so the graph can't contain cycles.
+	typedef std::function<bool()> TaskFn;
+	void addTask(const std::string& lrName, ThreadAffinity lAffinity, const std::vector<std::string>& lrDependencies,
+				 TaskFn lFunc);
+	
+	// Blocks until every task has run or one has failed; returns false on failure.  Main-thread tasks run on the
+	// calling thread, and the rest as jobs.  With no job system workers, the tasks all run on the calling thread, in
+	// the order they became ready.
+	bool run();
+	
+	void printReport() const;
+	
+private:
+	struct Task
+	{
+		std::string			mName;
+		ThreadAffinity		mAffinity;
+		TaskFn				mFunc;
+		std::vector<int>	mDependents;
+		int					mNumUnmetDependencies;
+		
+		InitGraph*			mpGraph;			// for the task's job
+		
+		// Results
+		double	mStartMS;
+		double	mEndMS;
+		int		mThreadIndex;		// 0 for the main thread; job system workers count from 1
+		bool	mSucceeded;
+	};
+	
+	int findTask(const std::string& lrName) const;
+	void makeReady(int lTaskIndex);
+	bool isFinished() const;
+	void runTask(int lTaskIndex, int lThreadIndex, std::unique_lock<std::mutex>& lrLock);
+	static void runTaskJob(void* lpTask);
+	
+	std::vector<Task> mTasks;
+	std::deque<int> mReadyMainTasks;
+	std::deque<int> mReadyAnyTasks;		// only when there are no workers; otherwise they're added as jobs straight away
+	int mNumRunning;
+	int mNumJobsWaiting;				// added as jobs, but not yet started
+	bool mFailed;
+	bool mAllowMainThreadForAny;		// when there are no workers to take them
+	JobCounter mJobs;
+	
+	std::mutex mMutex;
+	std::condition_variable mStateChanged;		// a task has become ready or finished
+	
+	double mStartMS;
+	double mEndMS;
+	int mNumThreads;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // INITGRAPH_H
@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------------
+// InputManager: Samples the player's actions once per simulation step, from
+//               the keyboard, a recorded log or an external controller, and
+//               can record them.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "inputmanager.h"
+
+#include "platform.h"
+#include "snapshot.h"
+#include "useful.h"
+#include <SDL/SDL_keyboard.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+//------------------------------------------------------------------------------
+// Log format: a fixed header, then one entry for each change of actions.  An entry is the number of steps since the
+// previous change (or the start) as a variable-length integer, then the new actions byte.  Holding a key for any
+// length of time therefore costs two or three bytes.
+//
+//	4 bytes		"TTIN"
+//	1 byte		version
+//	4 bytes		random seed
+//	2 bytes		simulation steps per second
+//	4 bytes		number of steps recorded
+//
+// Multi-byte values are little-endian.
+//------------------------------------------------------------------------------
+
+namespace
+{
+	const char kLogMagic[4] = { 'T', 'T', 'I', 'N' };
+	const uint8_t kLogVersion = 1;
+	const size_t kLogHeaderSize = 15;
+	const uint32_t kNoMoreChanges = 0xFFFFFFFF;
+	
+	//------------------------------------------------------------------------------
+	
+	void writeU8(std::vector<uint8_t>& lrBuf, uint8_t lVal)		{ lrBuf.push_back(lVal); }
+	void writeU16(std::vector<uint8_t>& lrBuf, uint16_t lVal)	{ writeU8(lrBuf, lVal & 0xFF); writeU8(lrBuf, lVal >> 8); }
+	void writeU32(std::vector<uint8_t>& lrBuf, uint32_t lVal)	{ writeU16(lrBuf, lVal & 0xFFFF); writeU16(lrBuf, lVal >> 16); }
+	
+	void writeVarUint(std::vector<uint8_t>& lrBuf, uint32_t lVal)
+	{
+		// 7 bits per byte, with the top bit set on all but the last byte
+		while (lVal >= 0x80)
+		{
+			lrBuf.push_back(uint8_t(lVal & 0x7F) | 0x80);
+			lVal >>= 7;
+		}
+		lrBuf.push_back(uint8_t(lVal));
+	}
+	
+	//------------------------------------------------------------------------------
+	
+	uint32_t readLittleEndian(const uint8_t* lpSrc, int lNumBytes)
+	{
+		uint32_t lVal = 0;
+		for (int li = lNumBytes - 1; li >= 0; --li)
+			lVal = (lVal << 8) | lpSrc[li];
+		return lVal;
+	}
+	
+	// Returns false if the buffer runs out first
+	bool readVarUint(const std::vector<uint8_t>& lrBuf, size_t* lpPos, uint32_t* lpValOut)
+	{
+		uint32_t lVal = 0;
+		for (int lShift = 0; lShift < 32; lShift += 7)
+		{
+			if (*lpPos >= lrBuf.size())
+				return false;
+			uint8_t lByte = lrBuf[(*lpPos)++];
+			lVal |= uint32_t(lByte & 0x7F) << lShift;
+			if ((lByte & 0x80) == 0)
+			{
+				*lpValOut = lVal;
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+//------------------------------------------------------------------------------
+// InputManager
+//------------------------------------------------------------------------------
+
+InputManager::InputManager() :
+	mLiveInputEnabled(false),
+	mExternalControls(false),
+	mActions(0),
+	mAccelControl(0.0f),
+	mSteerControl(0.0f),
+	mStep(0),
+	mRecording(false),
+	mRecordSeed(0),
+	mRecordStepRate(0),
+	mRecordStartStep(0),
+	mLastRecordedActions(0),
+	mLastRecordedStep(0),
+	mReplaying(false),
+	mReplaySeed(0),
+	mReplayStepRate(0),
+	mReplayNumSteps(0),
+	mReplayPos(0),
+	mNextReplayChangeStep(kNoMoreChanges),
+	mNextReplayActions(0),
+	mReplayActions(0)
+{
+}
+
+//------------------------------------------------------------------------------
+
+InputManager::~InputManager()
+{
+	shutDown();
+}
+
+//------------------------------------------------------------------------------
+
+bool InputManager::startReplay(const std::string& lrFileName)
+{
+	ASSERT2(!mRecording, "Start the replay first, so that it can be recorded");
+	
+	std::ifstream lSrc(lrFileName, std::ios::binary);
+	if (!lSrc.is_open())
+	{
+		printf("Error opening input log \"%s\"\n", lrFileName.c_str());
+		return false;
+	}
+	mReplayBuf.assign(std::istreambuf_iterator<char>(lSrc), std::istreambuf_iterator<char>());
+	
+	if (mReplayBuf.size() < kLogHeaderSize || !std::equal(kLogMagic, kLogMagic + 4, mReplayBuf.begin()))
+	{
+		printf("\"%s\" is not an input log\n", lrFileName.c_str());
+		return false;
+	}
+	if (mReplayBuf[4] != kLogVersion)
+	{
+		printf("Input log \"%s\" has unsupported version %d\n", lrFileName.c_str(), mReplayBuf[4]);
+		return false;
+	}
+	mReplaySeed = readLittleEndian(&mReplayBuf[5], 4);
+	mReplayStepRate = int(readLittleEndian(&mReplayBuf[9], 2));
+	mReplayNumSteps = readLittleEndian(&mReplayBuf[11], 4);
+	
+	printf("Replaying %u steps of input from \"%s\" (seed %u, %d steps per second)\n", mReplayNumSteps,
+		   lrFileName.c_str(), mReplaySeed, mReplayStepRate);
+	
+	mReplaying = true;
+	mStep = 0;
+	mReplayPos = kLogHeaderSize;
+	mReplayActions = 0;
+	mNextReplayChangeStep = 0;
+	readNextReplayChange();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::startRecording(const std::string& lrFileName, uint32_t lSeed, int lStepRate)
+{
+	printf("Recording input to \"%s\"\n", lrFileName.c_str());
+	
+	mRecording = true;
+	mRecordFileName = lrFileName;
+	mRecordSeed = lSeed;
+	mRecordStepRate = lStepRate;
+	mRecordBuf.clear();
+	mRecordStartStep = mStep;
+	mLastRecordedActions = 0;
+	mLastRecordedStep = mStep;
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::shutDown()
+{
+	mReplaying = false;
+	mReplayBuf.clear();
+	
+	if (!mRecording)
+		return;
+	mRecording = false;
+	
+	std::vector<uint8_t> lHeader;
+	lHeader.insert(lHeader.end(), kLogMagic, kLogMagic + 4);
+	writeU8(lHeader, kLogVersion);
+	writeU32(lHeader, mRecordSeed);
+	writeU16(lHeader, uint16_t(mRecordStepRate));
+	writeU32(lHeader, mStep - mRecordStartStep);
+	ASSERT(lHeader.size() == kLogHeaderSize);
+	
+	std::ofstream lDest(mRecordFileName, std::ios::binary);
+	if (!lDest.is_open())
+	{
+		printf("Error opening \"%s\" to record input\n", mRecordFileName.c_str());
+		return;
+	}
+	lDest.write(reinterpret_cast<const char*>(lHeader.data()), lHeader.size());
+	lDest.write(reinterpret_cast<const char*>(mRecordBuf.data()), mRecordBuf.size());
+	printf("Recorded %u steps of input to \"%s\" (%u bytes)\n", mStep - mRecordStartStep, mRecordFileName.c_str(),
+		   unsigned(lHeader.size() + mRecordBuf.size()));
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::setControls(float lAccel, float lSteer)
+{
+	mExternalControls = true;
+	mAccelControl = clamp(lAccel, -1.0f, 1.0f);
+	mSteerControl = clamp(lSteer, -1.0f, 1.0f);
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::sampleStep()
+{
+	if (mReplaying)
+		mActions = sampleReplay();
+	else if (!mExternalControls)
+		mActions = sampleLive();
+	
+	if (mExternalControls && !mReplaying)
+	{
+		// Only the directions can be recorded
+		mActions  = mAccelControl > 0.0f ? kAccelerate : mAccelControl < 0.0f ? kBrake : 0;
+		mActions |= mSteerControl < 0.0f ? kSteerLeft : mSteerControl > 0.0f ? kSteerRight : 0;
+	}
+	else
+		setControlsFromActions();
+	
+	if (mRecording && mActions != mLastRecordedActions)
+	{
+		writeVarUint(mRecordBuf, mStep - mLastRecordedStep);
+		writeU8(mRecordBuf, mActions);
+		mLastRecordedActions = mActions;
+		mLastRecordedStep = mStep;
+	}
+	
+	++mStep;
+}
+
+//------------------------------------------------------------------------------
+
+uint8_t InputManager::sampleLive() const
+{
+	if (!mLiveInputEnabled)
+		return 0;
+	
+	using Platform::isKeyHeld;
+	uint8_t lActions = 0;
+	if (isKeyHeld(SDLK_KP_8) || isKeyHeld(SDLK_UP))
+		lActions |= kAccelerate;
+	if (isKeyHeld(SDLK_KP_2) || isKeyHeld(SDLK_DOWN))
+		lActions |= kBrake;
+	if (isKeyHeld(SDLK_KP_4) || isKeyHeld(SDLK_LEFT))
+		lActions |= kSteerLeft;
+	if (isKeyHeld(SDLK_KP_6) || isKeyHeld(SDLK_RIGHT))
+		lActions |= kSteerRight;
+	return lActions;
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::setControlsFromActions()
+{
+	// Braking wins over accelerating, and steering both ways at once cancels out
+	if (isHeld(kBrake))
+		mAccelControl = -1.0f;
+	else if (isHeld(kAccelerate))
+		mAccelControl = 1.0f;
+	else
+		mAccelControl = 0.0f;
+	
+	bool lLeft  = isHeld(kSteerLeft);
+	bool lRight = isHeld(kSteerRight);
+	if (lLeft ^ lRight)
+		mSteerControl = lLeft ? -1.0f : +1.0f;
+	else
+		mSteerControl = 0.0f;
+}
+
+//------------------------------------------------------------------------------
+
+uint8_t InputManager::sampleReplay()
+{
+	if (mStep >= mReplayNumSteps)
+	{
+		printf("Replay finished after %u steps; switching to live input\n", mStep);
+		mReplaying = false;		// the log is kept, in case a snapshot takes the replay back
+		return sampleLive();
+	}
+	
+	while (mStep >= mNextReplayChangeStep)
+	{
+		mReplayActions = mNextReplayActions;
+		readNextReplayChange();
+	}
+	return mReplayActions;
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::readNextReplayChange()
+{
+	if (mReplayPos >= mReplayBuf.size())
+	{
+		mNextReplayChangeStep = kNoMoreChanges;
+		return;
+	}
+	
+	uint32_t lStepDelta;
+	if (!readVarUint(mReplayBuf, &mReplayPos, &lStepDelta) || mReplayPos >= mReplayBuf.size())
+	{
+		printf("Input log is truncated; ignoring the rest\n");
+		mReplayPos = mReplayBuf.size();
+		mNextReplayChangeStep = kNoMoreChanges;
+		return;
+	}
+	mNextReplayActions = mReplayBuf[mReplayPos++];
+	mNextReplayChangeStep += lStepDelta;
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::saveState(SnapshotWriter& lrWriter) const
+{
+	lrWriter.write(mActions);
+	lrWriter.write(mAccelControl);
+	lrWriter.write(mSteerControl);
+	lrWriter.write(mStep);
+	
+	lrWriter.write(uint32_t(mRecordBuf.size()));
+	lrWriter.write(mLastRecordedActions);
+	lrWriter.write(mLastRecordedStep);
+	
+	lrWriter.write(uint8_t(mReplaying));
+	lrWriter.write(uint32_t(mReplayPos));
+	lrWriter.write(mNextReplayChangeStep);
+	lrWriter.write(mNextReplayActions);
+	lrWriter.write(mReplayActions);
+}
+
+//------------------------------------------------------------------------------
+
+void InputManager::loadState(SnapshotReader& lrReader)
+{
+	lrReader.read(&mActions);
+	lrReader.read(&mAccelControl);
+	lrReader.read(&mSteerControl);
+	lrReader.read(&mStep);
+	
+	uint32_t lRecordBufSize;
+	lrReader.read(&lRecordBufSize);
+	lrReader.read(&mLastRecordedActions);
+	lrReader.read(&mLastRecordedStep);
+	if (lRecordBufSize < mRecordBuf.size())
+		mRecordBuf.resize(lRecordBufSize);
+	
+	uint8_t lReplaying;
+	uint32_t lReplayPos;
+	lrReader.read(&lReplaying);
+	lrReader.read(&lReplayPos);
+	lrReader.read(&mNextReplayChangeStep);
+	lrReader.read(&mNextReplayActions);
+	lrReader.read(&mReplayActions);
+	mReplaying = lReplaying != 0 && !mReplayBuf.empty();
+	mReplayPos = lReplayPos;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+// InputManager: Samples the player's actions once per simulation step, from
+//               the keyboard, a recorded log or an external controller, and
+//               can record them.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef INPUTMANAGER_H
+#define INPUTMANAGER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class SnapshotReader;
+class SnapshotWriter;
+
+//------------------------------------------------------------------------------
+
+class InputManager
+{
+public:
+	InputManager();
+	~InputManager();
+	
+	enum Action
+	{
+		kAccelerate		= 1 << 0,
+		kBrake			= 1 << 1,
+		kSteerLeft		= 1 << 2,
+		kSteerRight		= 1 << 3
+	};
+	
+	// A replay replaces live input until it runs out.  The seed and step rate are stored in a recording, as the
+	// replay only matches if they're the same.
+	bool startReplay(const std::string& lrFileName);
+	void startRecording(const std::string& lrFileName, uint32_t lSeed, int lStepRate);
+	void shutDown();		// writes out any recording
+	
+	// Off by default: only the world on screen reads the keyboard
+	void setLiveInputEnabled(bool lEnabled) { mLiveInputEnabled = lEnabled; }
+	
+	// An external controller (see envapi.h) replaces live input from the next step on.  The values are analogue,
+	// in [-1, 1], and are held until changed.
+	void setControls(float lAccel, float lSteer);
+	
+	// Call once per simulation step, before anything checks the actions
+	void sampleStep();
+	
+	bool isHeld(Action lAction) const { return (mActions & lAction) != 0; }
+	uint8_t actions() const { return mActions; }
+	
+	// The car controls for this step, from whichever source
+	float accelControl() const { return mAccelControl; }	// >0 => accelerate; <0 => brake/reverse accelerate
+	float steerControl() const { return mSteerControl; }	// <0 => left; >0 => right
+	
+	bool isReplaying() const { return mReplaying; }
+	uint32_t replaySeed() const { return mReplaySeed; }
+	int replayStepRate() const { return mReplayStepRate; }
+	uint32_t replayNumSteps() const { return mReplayNumSteps; }
+	
+	// Loading a snapshot takes a replay back to the same point, and drops anything recorded since it was saved
+	void saveState(SnapshotWriter& lrWriter) const;
+	void loadState(SnapshotReader& lrReader);
+	
+private:
+	uint8_t sampleLive() const;
+	uint8_t sampleReplay();
+	void readNextReplayChange();
+	void setControlsFromActions();
+	
+	bool mLiveInputEnabled;
+	bool mExternalControls;
+	uint8_t mActions;
+	float mAccelControl;
+	float mSteerControl;
+	uint32_t mStep;				// steps sampled so far (since the replay started, if there is one)
+	
+	// Recording: the actions are only stored when they change, as the number of steps since the last change
+	bool mRecording;
+	std::string mRecordFileName;
+	uint32_t mRecordSeed;
+	int mRecordStepRate;
+	uint32_t mRecordStartStep;
+	std::vector<uint8_t> mRecordBuf;
+	uint8_t mLastRecordedActions;
+	uint32_t mLastRecordedStep;
+	
+	// Replay
+	bool mReplaying;
+	uint32_t mReplaySeed;
+	int mReplayStepRate;
+	uint32_t mReplayNumSteps;
+	std::vector<uint8_t> mReplayBuf;
+	size_t mReplayPos;
+	uint32_t mNextReplayChangeStep;
+	uint8_t mNextReplayActions;
+	uint8_t mReplayActions;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // INPUTMANAGER_H
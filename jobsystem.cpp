@@ -0,0 +1,267 @@
+//------------------------------------------------------------------------------
+// JobSystem: A pool of worker threads shared by everything in the process.
+//            Each thread has its own queue of jobs, and threads that run out
+//            take the oldest jobs from the others' queues.  Where there are no
+//            threads, jobs run as soon as they're added.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "jobsystem.h"
+
+#include "useful.h"
+#include <cstdio>
+
+//------------------------------------------------------------------------------
+
+JobSystem gJobSystem;
+thread_local int JobSystem::msThreadQueue = 0;
+
+//------------------------------------------------------------------------------
+
+JobSystem::JobSystem() :
+	mNumQueued(0),
+	mQuit(false)
+{
+}
+
+//------------------------------------------------------------------------------
+
+JobSystem::~JobSystem()
+{
+	shutDown();
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::init(int lNumWorkers)
+{
+	ASSERT(mWorkers.empty());
+	mQuit = false;
+	for (int lIndex = 0; lIndex <= lNumWorkers; ++lIndex)
+		mQueues.push_back(new Queue);
+	for (int lIndex = 1; lIndex <= lNumWorkers; ++lIndex)
+		mWorkers.push_back(std::thread(&JobSystem::runWorker, this, lIndex));
+	printf("Job system running on %d thread%s\n", numThreads(), numThreads() == 1 ? "" : "s");
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::shutDown()
+{
+	{
+		std::lock_guard<std::mutex> lLock(mSleepMutex);
+		mQuit = true;
+	}
+	mWakeWorkers.notify_all();
+	for (std::thread& lrWorker: mWorkers)
+		lrWorker.join();
+	mWorkers.clear();
+	
+	ASSERT2(mNumQueued == 0, "Jobs were left unfinished");
+	for (Queue* lpQueue: mQueues)
+		delete lpQueue;
+	mQueues.clear();
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::add(JobFn lpFunc, void* lpContext, JobCounter* lpCounter, JobCounter* lpAfter)
+{
+	if (lpCounter != nullptr)
+		++lpCounter->mNumPending;
+	Job lJob = { lpFunc, lpContext, lpCounter };
+	
+	if (lpAfter != nullptr)
+	{
+		std::lock_guard<std::mutex> lLock(lpAfter->mMutex);
+		if (lpAfter->mNumPending > 0)
+		{
+			lpAfter->mWaitingJobs.push_back(lJob);
+			return;
+		}
+	}
+	schedule(lJob);
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::wait(JobCounter& lrCounter)
+{
+	while (lrCounter.mNumPending > 0)
+	{
+		Job lJob;
+		if (takeJob(&lJob))
+		{
+			run(lJob);
+			continue;
+		}
+		
+		// What's left is running on other threads (or held back behind them), so sleep rather than spin.  The last
+		// one to finish wakes this, and it takes the lock to do so, so it can't be missed.
+		std::unique_lock<std::mutex> lLock(lrCounter.mMutex);
+		lrCounter.mDone.wait(lLock, [&lrCounter]() { return lrCounter.mNumPending == 0; });
+	}
+	
+	// The last job to finish may still be releasing the counter's waiting jobs
+	std::lock_guard<std::mutex> lLock(lrCounter.mMutex);
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::parallelFor(size_t lBegin, size_t lEnd, size_t lGrainSize, RangeFn lpFunc, const void* lpContext)
+{
+	if (lBegin >= lEnd)
+		return;
+	
+	RangeSet lRangeSet;
+	lRangeSet.mpFunc = lpFunc;
+	lRangeSet.mpContext = lpContext;
+	lRangeSet.mBegin = lBegin;
+	lRangeSet.mEnd = lEnd;
+	lRangeSet.mGrainSize = max(lGrainSize, size_t(1));
+	lRangeSet.mNumRanges = (lEnd - lBegin + lRangeSet.mGrainSize - 1) / lRangeSet.mGrainSize;
+	lRangeSet.mNextRange = 0;
+	
+	// A job for each other thread that could help; the calling thread is one of the threads
+	JobCounter lCounter;
+	size_t lNumJobs = min(lRangeSet.mNumRanges, size_t(numThreads())) - 1;
+	for (size_t lJob = 0; lJob < lNumJobs; ++lJob)
+		add(&JobSystem::runRanges, &lRangeSet, &lCounter);
+	runRanges(&lRangeSet);
+	wait(lCounter);
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::runRanges(void* lpRangeSet)
+{
+	RangeSet& lrRangeSet = *static_cast<RangeSet*>(lpRangeSet);
+	for (;;)
+	{
+		size_t lRange = lrRangeSet.mNextRange++;
+		if (lRange >= lrRangeSet.mNumRanges)
+			return;
+		size_t lRangeBegin = lrRangeSet.mBegin + lRange * lrRangeSet.mGrainSize;
+		lrRangeSet.mpFunc(lrRangeSet.mpContext, lRangeBegin, min(lRangeBegin + lrRangeSet.mGrainSize, lrRangeSet.mEnd));
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::schedule(Job& lrJob)
+{
+	if (mWorkers.empty())
+	{
+		run(lrJob);
+		return;
+	}
+	
+	{
+		Queue& lrQueue = *mQueues[msThreadQueue];
+		std::unique_lock<std::mutex> lLock(lrQueue.mMutex);
+		if (lrQueue.mSize == Queue::kCapacity)
+		{
+			lLock.unlock();
+			run(lrJob);
+			return;
+		}
+		lrQueue.mJobs[(lrQueue.mFirst + lrQueue.mSize) % Queue::kCapacity] = lrJob;
+		++lrQueue.mSize;
+	}
+	++mNumQueued;
+	
+	// Taking the lock means a worker can't miss this between checking for jobs and going to sleep
+	{
+		std::lock_guard<std::mutex> lLock(mSleepMutex);
+	}
+	mWakeWorkers.notify_one();
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::run(Job& lrJob)
+{
+	lrJob.mpFunc(lrJob.mpContext);
+	if (lrJob.mpCounter != nullptr)
+		finish(*lrJob.mpCounter);
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::finish(JobCounter& lrCounter)
+{
+	std::vector<Job> lReleasedJobs;
+	{
+		std::lock_guard<std::mutex> lLock(lrCounter.mMutex);
+		if (--lrCounter.mNumPending == 0)
+		{
+			lReleasedJobs.swap(lrCounter.mWaitingJobs);
+			lrCounter.mDone.notify_all();
+		}
+	}
+	
+	// The counter may be gone by now
+	for (Job& lrJob: lReleasedJobs)
+		schedule(lrJob);
+}
+
+//------------------------------------------------------------------------------
+
+bool JobSystem::takeJob(Job* lpJobOut)
+{
+	if (mNumQueued == 0)
+		return false;
+	
+	// Newest first from this thread's own queue, as its data is most likely to still be in the cache
+	{
+		Queue& lrQueue = *mQueues[msThreadQueue];
+		std::lock_guard<std::mutex> lLock(lrQueue.mMutex);
+		if (lrQueue.mSize > 0)
+		{
+			--lrQueue.mSize;
+			*lpJobOut = lrQueue.mJobs[(lrQueue.mFirst + lrQueue.mSize) % Queue::kCapacity];
+			--mNumQueued;
+			return true;
+		}
+	}
+	
+	// Oldest first from the others, as those are likely to be the biggest pieces of work left
+	for (size_t lOffset = 1; lOffset < mQueues.size(); ++lOffset)
+	{
+		Queue& lrQueue = *mQueues[(msThreadQueue + lOffset) % mQueues.size()];
+		std::lock_guard<std::mutex> lLock(lrQueue.mMutex);
+		if (lrQueue.mSize > 0)
+		{
+			*lpJobOut = lrQueue.mJobs[lrQueue.mFirst];
+			lrQueue.mFirst = (lrQueue.mFirst + 1) % Queue::kCapacity;
+			--lrQueue.mSize;
+			--mNumQueued;
+			return true;
+		}
+	}
+	return false;
+}
+
+//------------------------------------------------------------------------------
+
+void JobSystem::runWorker(int lQueueIndex)
+{
+	msThreadQueue = lQueueIndex;
+	for (;;)
+	{
+		Job lJob;
+		if (takeJob(&lJob))
+		{
+			run(lJob);
+			continue;
+		}
+		
+		std::unique_lock<std::mutex> lLock(mSleepMutex);
+		mWakeWorkers.wait(lLock, [this]() { return mQuit || mNumQueued > 0; });
+		if (mQuit)
+			return;
+	}
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,140 @@
+//------------------------------------------------------------------------------
+// JobSystem: A pool of worker threads shared by everything in the process.
+//            Each thread has its own queue of jobs, and threads that run out
+//            take the oldest jobs from the others' queues.  Where there are no
+//            threads, jobs run as soon as they're added.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class JobCounter;
+
+// A plain function and its data rather than a std::function, so that adding a job never allocates
+typedef void (*JobFn)(void* lpContext);
+
+struct Job
+{
+	JobFn mpFunc;
+	void* mpContext;
+	JobCounter* mpCounter;		// counts this job until it finishes; may be null
+};
+
+//------------------------------------------------------------------------------
+
+// Counts jobs that haven't finished yet.  Jobs can be held back until a counter reaches zero, and wait() helps run
+// jobs until it does.  A counter can be reused once it's reached zero.
+class JobCounter
+{
+public:
+	JobCounter() : mNumPending(0) {}
+	
+	bool isDone() const { return mNumPending == 0; }
+	
+private:
+	friend class JobSystem;
+	
+	std::atomic<int> mNumPending;
+	std::mutex mMutex;					// for mWaitingJobs, and the count reaching zero
+	std::condition_variable mDone;		// the count has reached zero
+	std::vector<Job> mWaitingJobs;		// held back until the count reaches zero
+};
+
+//------------------------------------------------------------------------------
+
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+	
+	// With no workers (or before init()), every job runs on the thread that adds it
+	void init(int lNumWorkers);
+	void shutDown();		// any jobs should have been waited for first
+	
+	bool isRunning() const { return !mQueues.empty(); }		// between init() and shutDown()
+	int numThreads() const { return int(mWorkers.size()) + 1; }
+	static int threadIndex() { return msThreadQueue; }		// workers count from 1; any other thread is 0
+	
+	// Counts the job in lpCounter, if given, until it finishes.  If lpAfter is given, the job doesn't start until
+	// that counter reaches zero (and holding it back allocates).  lpContext has to outlive the job.
+	void add(JobFn lpFunc, void* lpContext, JobCounter* lpCounter = nullptr, JobCounter* lpAfter = nullptr);
+	
+	// Runs jobs on the calling thread until the counter reaches zero.  Once there are none left to take, it sleeps
+	// until the ones still running on other threads have finished.
+	void wait(JobCounter& lrCounter);
+	
+	// Calls lrFunc(lRangeBegin, lRangeEnd) for each range of up to lGrainSize indices in [lBegin, lEnd), spread over
+	// the threads, and returns once they've all finished.  The calling thread takes ranges too.  There's a job for
+	// each thread rather than each range, and each takes ranges until there are none left, so nothing is allocated.
+	template <typename Func> void parallelFor(size_t lBegin, size_t lEnd, size_t lGrainSize, const Func& lrFunc)
+	{
+		parallelFor(lBegin, lEnd, lGrainSize, [](const void* lpFunc, size_t lRangeBegin, size_t lRangeEnd)
+					{
+						(*static_cast<const Func*>(lpFunc))(lRangeBegin, lRangeEnd);
+					}, &lrFunc);
+	}
+	
+private:
+	typedef void (*RangeFn)(const void* lpContext, size_t lRangeBegin, size_t lRangeEnd);
+	
+	// A ring buffer, allocated once; if it fills up, further jobs just run straight away
+	struct Queue
+	{
+		static const size_t kCapacity = 1024;
+		
+		Queue() : mJobs(kCapacity), mFirst(0), mSize(0) {}
+		
+		std::mutex mMutex;
+		std::vector<Job> mJobs;
+		size_t mFirst;
+		size_t mSize;
+	};
+	
+	// One parallelFor() call, shared by its jobs
+	struct RangeSet
+	{
+		RangeFn mpFunc;
+		const void* mpContext;
+		size_t mBegin;
+		size_t mEnd;
+		size_t mGrainSize;
+		size_t mNumRanges;
+		std::atomic<size_t> mNextRange;
+	};
+	
+	void parallelFor(size_t lBegin, size_t lEnd, size_t lGrainSize, RangeFn lpFunc, const void* lpContext);
+	static void runRanges(void* lpRangeSet);
+	
+	void schedule(Job& lrJob);
+	void run(Job& lrJob);
+	void finish(JobCounter& lrCounter);
+	bool takeJob(Job* lpJobOut);		// the newest from this thread's queue, or else the oldest from another's
+	void runWorker(int lQueueIndex);
+	
+	std::vector<std::thread> mWorkers;
+	std::vector<Queue*> mQueues;		// the first is shared by all the threads that aren't workers
+	std::atomic<int> mNumQueued;
+	std::mutex mSleepMutex;
+	std::condition_variable mWakeWorkers;
+	bool mQuit;
+	
+	static thread_local int msThreadQueue;
+};
+
+extern JobSystem gJobSystem;
+
+//------------------------------------------------------------------------------
+
+#endif // JOBSYSTEM_H
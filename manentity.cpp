@@ -6,27 +6,52 @@
 
 #include "manentity.h"
 
-#include "app.h"
 #include "entitymanager.h"
 #include "houseentity.h"
 #include "settings.h"
+#include "snapshot.h"
 #include "texturemanager.h"
-#include <emscripten/emscripten.h>
+#include "world.h"
+#include <cmath>
+#include <new>
 #include <string>
 #include <sstream>
 
+//------------------------------------------------------------------------------
+// Factory
+//------------------------------------------------------------------------------
+
+// Parameters: x, y, texture index
+Entity* spawnManEntity(World* lpWorld, void* lpMemory, const float* lpParams)
+{
+	return new (lpMemory) ManEntity(lpWorld, lpParams[0], lpParams[1], int(lpParams[2]));
+}
+
+SpawnableEntityFactory<ManEntity> sManEntityFactory(ManEntity::kType, nullptr, &spawnManEntity);
+
+// Parameters: x, y of the bottom of the house it's by, and where the passenger was picked up
+Entity* spawnTargetEntity(World* lpWorld, void* lpMemory, const float* lpParams)
+{
+	TargetEntity* lpTarget = new (lpMemory) TargetEntity(lpWorld, lpParams[0], 0.0f);
+	lpTarget->setY(lpParams[1] + lpTarget->halfHeight());
+	lpTarget->setCashValueFromDistance(lpParams[2], lpParams[3]);
+	return lpTarget;
+}
+
+SpawnableEntityFactory<TargetEntity> sTargetEntityFactory(TargetEntity::kType, nullptr, &spawnTargetEntity);
+
 //------------------------------------------------------------------------------
 // ManEntity
 //------------------------------------------------------------------------------
 
-ManEntity::ManEntity(float lX, float lY) :
-	CollidableEntity(lX, lY)
+ManEntity::ManEntity(World* lpWorld, float lX, float lY, int lTexIndex) :
+	CollidableEntity(lpWorld, lX, lY)
 {
-	int lTexIndex = 1 + int(emscripten_random() * 5.0f);
 	std::string lTexName = (std::ostringstream() << "data/tex/man-" << lTexIndex << ".png").str();
 	setTexture(gTextureManager.load(lTexName));
 	
 	setCollisionTriggersEvent(true);
+	setActivity(kSleepy);
 }
 
 //------------------------------------------------------------------------------
@@ -34,35 +59,25 @@ ManEntity::ManEntity(float lX, float lY) :
 void ManEntity::triggerCollisionEvent()
 {
 	// Don't pick up a passenger if we already have one
-	if (gApplication.havePassenger())
+	World& lrWorld = *world();
+	if (lrWorld.havePassenger())
 		return;
 	
-	HouseEntity* lpHouse = gApplication.pickRandomHouse();
-	TargetEntity* lpTarget = new TargetEntity(lpHouse->x(), 0.0f);
-	float lTargetY = lpHouse->y() + lpHouse->halfHeight() + lpTarget->halfHeight();
-	lpTarget->setY(lTargetY);
-	lpTarget->setCashValueFromDistance(x(), y());
-	gEntityManager.registerEntity(lpTarget);
-	
-	gApplication.setStatusMessage(lpHouse->getStartMessage(), lpHouse->getStartMessage2());
-	gApplication.setCurrentTarget(lpTarget);
-	gApplication.startCountdown();
-	
-	gApplication.playSound("collect", 3);
-	
-	kill();
+	lrWorld.startFare(lrWorld.pickRandomHouse(), x(), y());
+	lrWorld.entities().commands().kill(handle());
 }
 
 //------------------------------------------------------------------------------
 // TargetEntity
 //------------------------------------------------------------------------------
 
-TargetEntity::TargetEntity(float lX, float lY) :
-	CollidableEntity(lX, lY),
+TargetEntity::TargetEntity(World* lpWorld, float lX, float lY) :
+	CollidableEntity(lpWorld, lX, lY),
 	mCashValue(1)
 {
 	setTexture(gTextureManager.load("data/tex/x.png"));
 	setCollisionTriggersEvent(true);
+	setActivity(kSleepy);
 }
 
 //------------------------------------------------------------------------------
@@ -85,8 +100,26 @@ void TargetEntity::setCashValueFromDistance(float lStartX, float lStartY)
 
 void TargetEntity::triggerCollisionEvent()
 {
-	gApplication.winPassenger(mCashValue);
-	kill();
+	world()->winPassenger(mCashValue);
+	world()->entities().commands().kill(handle());
+}
+
+//------------------------------------------------------------------------------
+
+void TargetEntity::saveState(SnapshotWriter& lrWriter) const
+{
+	CollidableEntity::saveState(lrWriter);
+	lrWriter.write(int32_t(mCashValue));
+}
+
+//------------------------------------------------------------------------------
+
+void TargetEntity::loadState(SnapshotReader& lrReader)
+{
+	CollidableEntity::loadState(lrReader);
+	int32_t lCashValue;
+	lrReader.read(&lCashValue);
+	mCashValue = lCashValue;
 }
 
 //------------------------------------------------------------------------------
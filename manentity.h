@@ -14,9 +14,12 @@
 class ManEntity : public CollidableEntity
 {
 public:
-	ManEntity(float lX, float lY);
+	ManEntity(World* lpWorld, float lX, float lY, int lTexIndex);		// textures are numbered from 1
 	
-	virtual const char* type() const { return "man"; }
+	static constexpr const char* kType = "man";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	virtual void triggerCollisionEvent();
 };
@@ -26,11 +29,16 @@ public:
 class TargetEntity : public CollidableEntity
 {
 public:
-	TargetEntity(float lX, float lY);
+	TargetEntity(World* lpWorld, float lX, float lY);
 	
-	virtual const char* type() const { return "target"; }
+	static constexpr const char* kType = "target";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	virtual void triggerCollisionEvent();
+	virtual void saveState(SnapshotWriter& lrWriter) const;
+	virtual void loadState(SnapshotReader& lrReader);
 	
 	void setCashValue(int lValue) { mCashValue = lValue; }
 	void setCashValueFromDistance(float lStartX, float lStartY);
@@ -0,0 +1,73 @@
+//------------------------------------------------------------------------------
+// Name: A string interned in a table shared by the whole process, so that it
+//       can be compared and used as an index like a plain integer.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "name.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	struct NameTable
+	{
+		NameTable()
+		{
+			mIndices[std::string()] = 0;
+			mStrings.push_back(std::string());
+		}
+		
+		std::mutex mMutex;
+		std::unordered_map<std::string, uint32_t> mIndices;
+		std::vector<std::string> mStrings;		// by index
+	};
+	
+	// Function-local, as names may be made during static initialisation
+	NameTable& nameTable()
+	{
+		static NameTable sTable;
+		return sTable;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+Name::Name(const char* lpString) :
+	Name(std::string(lpString))
+{
+}
+
+//------------------------------------------------------------------------------
+
+Name::Name(const std::string& lrString)
+{
+	NameTable& lrTable = nameTable();
+	std::lock_guard<std::mutex> lLock(lrTable.mMutex);
+	auto lIter = lrTable.mIndices.find(lrString);
+	if (lIter != lrTable.mIndices.end())
+	{
+		mIndex = lIter->second;
+		return;
+	}
+	
+	mIndex = uint32_t(lrTable.mStrings.size());
+	lrTable.mIndices[lrString] = mIndex;
+	lrTable.mStrings.push_back(lrString);
+}
+
+//------------------------------------------------------------------------------
+
+std::string Name::str() const
+{
+	NameTable& lrTable = nameTable();
+	std::lock_guard<std::mutex> lLock(lrTable.mMutex);
+	return lrTable.mStrings[mIndex];
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,39 @@
+//------------------------------------------------------------------------------
+// Name: A string interned in a table shared by the whole process, so that it
+//       can be compared and used as an index like a plain integer.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef NAME_H
+#define NAME_H
+
+#include <cstdint>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+// The first time a string is seen, it's copied into the table; after that, making a name from it is one hash lookup
+// and doesn't allocate (for strings short enough for std::string to keep inline).  Names can be made on any thread.
+class Name
+{
+public:
+	Name() : mIndex(0) {}		// the empty string
+	explicit Name(const char* lpString);
+	explicit Name(const std::string& lrString);
+	
+	// Indices count up from 0 (the empty string) in the order strings are first seen, so they can index arrays
+	uint32_t index() const { return mIndex; }
+	bool isEmpty() const { return mIndex == 0; }
+	std::string str() const;		// a copy, as the table may be growing on another thread
+	
+	bool operator==(Name lOther) const { return mIndex == lOther.mIndex; }
+	bool operator!=(Name lOther) const { return mIndex != lOther.mIndex; }
+	
+private:
+	uint32_t mIndex;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // NAME_H
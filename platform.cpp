@@ -0,0 +1,377 @@
+//------------------------------------------------------------------------------
+// Platform: Wraps the services that differ between the Emscripten (browser)
+//           build and the native (Linux/SDL2) build - the main loop, the clock,
+//           the window and the page elements around the canvas.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "platform.h"
+
+#include "useful.h"
+#include <SDL/SDL.h>
+
+#ifndef PLATFORM_NATIVE
+
+//------------------------------------------------------------------------------
+// Emscripten backend
+//------------------------------------------------------------------------------
+
+#include <emscripten/emscripten.h>
+#include <ctime>
+#include <SDL/SDL_compat.h>
+#include <SDL/SDL_keyboard.h>
+
+// Functions defined in JavaScript in the HTML file
+extern "C" {
+	extern void page_toggleMusic();
+	extern bool page_isMusicEnabled();
+	extern void page_toggleDebug();
+	extern bool page_isDebugEnabled();
+}
+
+namespace
+{
+	SDL_Surface* spDisplaySurface = nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::runMainLoop(MainLoopFn lpLoopFunc)
+{
+	emscripten_set_main_loop(lpLoopFunc, 0, 0);
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::cancelMainLoop()
+{
+	emscripten_cancel_main_loop();
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::setMainLoopRate(float lFPS)
+{
+	if (lFPS <= 0.0f)
+		emscripten_set_main_loop_timing(EM_TIMING_RAF, 1);
+	else
+		emscripten_set_main_loop_timing(EM_TIMING_SETTIMEOUT, int(1000.0f / lFPS));
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::canSleep()
+{
+	return false;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::sleepUntil(double lTimeMS, bool lPrecise)
+{
+	// Blocking would stall the browser; the rate given to setMainLoopRate() does the job instead
+}
+
+//------------------------------------------------------------------------------
+
+double Platform::getTimeMS()
+{
+	return emscripten_get_now();
+}
+
+//------------------------------------------------------------------------------
+
+double Platform::getThreadCPUTimeMS()
+{
+	// There's only the one thread
+	return double(clock()) * (1000.0 / double(CLOCKS_PER_SEC));
+}
+
+//------------------------------------------------------------------------------
+
+int Platform::numWorkerThreads()
+{
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::openWindow(int lWidth, int lHeight)
+{
+	spDisplaySurface = SDL_SetVideoMode(lWidth, lHeight, 32, SDL_HWSURFACE | SDL_GL_DOUBLEBUFFER | SDL_OPENGL);
+	if (spDisplaySurface == nullptr)
+	{
+		printf("Failed to set SDL video mode %dx%dx32\n", lWidth, lHeight);
+		return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::closeWindow()
+{
+	if (spDisplaySurface != nullptr)
+	{
+		SDL_FreeSurface(spDisplaySurface);
+		spDisplaySurface = nullptr;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::swapBuffers()
+{
+	SDL_GL_SwapBuffers();
+}
+
+//------------------------------------------------------------------------------
+
+SDL_Surface* Platform::getDisplaySurface()
+{
+	return spDisplaySurface;
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::isWindowVisible()
+{
+	// Browsers already stop calling back for hidden pages
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+SDL_Surface* Platform::convertSurfaceForGL(SDL_Surface* lpSurface)
+{
+	// Emscripten always decodes to RGBA
+	return lpSurface;
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::isKeyHeld(int lKeyCode)
+{
+	// Emscripten's keyboard state is indexed by key code
+	int lNumKeys;
+	uint8_t* lpKeysHeld = SDL_GetKeyboardState(&lNumKeys);
+	return lpKeysHeld[lKeyCode] != 0;
+}
+
+//------------------------------------------------------------------------------
+
+std::string Platform::getFontFileName(const std::string& lrFace)
+{
+	// The browser looks fonts up by face name
+	return lrFace;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::pageToggleMusic()		{ page_toggleMusic(); }
+bool Platform::pageIsMusicEnabled()		{ return page_isMusicEnabled(); }
+void Platform::pageToggleDebug()		{ page_toggleDebug(); }
+bool Platform::pageIsDebugEnabled()		{ return page_isDebugEnabled(); }
+
+#else	// PLATFORM_NATIVE
+
+//------------------------------------------------------------------------------
+// Native backend
+//------------------------------------------------------------------------------
+
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+namespace
+{
+	SDL_Window*		spWindow = nullptr;
+	SDL_GLContext	spGLContext = nullptr;
+	bool			sMainLoopRunning = false;
+	bool			sMusicEnabled = true;		// matches the default state of the check boxes on the page
+	bool			sDebugEnabled = false;		//
+	
+	const std::chrono::steady_clock::time_point kStartTime = std::chrono::steady_clock::now();
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::runMainLoop(MainLoopFn lpLoopFunc)
+{
+	sMainLoopRunning = true;
+	while (sMainLoopRunning)
+		lpLoopFunc();
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::cancelMainLoop()
+{
+	sMainLoopRunning = false;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::setMainLoopRate(float lFPS)
+{
+	// The loop runs flat out; the frame scheduler sleeps between frames
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::canSleep()
+{
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::sleepUntil(double lTimeMS, bool lPrecise)
+{
+	// Sleeps can overshoot by a millisecond or more, so precise ones sleep for most of the time and then spin for the
+	// rest.  Spinning keeps a core busy, so the others sleep all the way.
+	const double kSpinMS = lPrecise ? 1.5 : 0.0;
+	double lRemainingMS = lTimeMS - getTimeMS();
+	if (lRemainingMS > kSpinMS)
+		std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(lRemainingMS - kSpinMS));
+	while (lPrecise && getTimeMS() < lTimeMS)
+		std::this_thread::yield();
+}
+
+//------------------------------------------------------------------------------
+
+double Platform::getTimeMS()
+{
+	// Relative to start-up, so the values stay small enough to survive conversion to float seconds
+	std::chrono::duration<double, std::milli> lElapsed = std::chrono::steady_clock::now() - kStartTime;
+	return lElapsed.count();
+}
+
+//------------------------------------------------------------------------------
+
+double Platform::getThreadCPUTimeMS()
+{
+	// Not clock(), which counts the worker threads' time too
+	timespec lTime;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &lTime);
+	return double(lTime.tv_sec) * 1000.0 + double(lTime.tv_nsec) * 1.0e-6;
+}
+
+//------------------------------------------------------------------------------
+
+int Platform::numWorkerThreads()
+{
+	// The count can be unknown (zero), but even a single core gains from overlapping file reads
+	return max(int(std::thread::hardware_concurrency()) - 1, 1);
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::openWindow(int lWidth, int lHeight)
+{
+	// Ask for the same GLES 2 context we get in the browser
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	
+	spWindow = SDL_CreateWindow("Ten-Second Taxi", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, lWidth, lHeight,
+								SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN);
+	if (spWindow == nullptr)
+	{
+		printf("Failed to create a %dx%d window: %s\n", lWidth, lHeight, SDL_GetError());
+		return false;
+	}
+	
+	spGLContext = SDL_GL_CreateContext(spWindow);
+	if (spGLContext == nullptr)
+	{
+		printf("Failed to create a GL context: %s\n", SDL_GetError());
+		closeWindow();
+		return false;
+	}
+	
+	SDL_GL_SetSwapInterval(1);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::closeWindow()
+{
+	if (spGLContext != nullptr)
+	{
+		SDL_GL_DeleteContext(spGLContext);
+		spGLContext = nullptr;
+	}
+	if (spWindow != nullptr)
+	{
+		SDL_DestroyWindow(spWindow);
+		spWindow = nullptr;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::swapBuffers()
+{
+	SDL_GL_SwapWindow(spWindow);
+}
+
+//------------------------------------------------------------------------------
+
+SDL_Surface* Platform::getDisplaySurface()
+{
+	// SDL2 doesn't provide a surface for GL windows
+	return nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::isWindowVisible()
+{
+	if (spWindow == nullptr)
+		return false;
+	return (SDL_GetWindowFlags(spWindow) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED)) == 0;
+}
+
+//------------------------------------------------------------------------------
+
+SDL_Surface* Platform::convertSurfaceForGL(SDL_Surface* lpSurface)
+{
+	// SDL2 keeps whatever layout the image or font renderer produced
+	if (lpSurface == nullptr || lpSurface->format->format == SDL_PIXELFORMAT_ABGR8888)
+		return lpSurface;
+	
+	SDL_Surface* lpConverted = SDL_ConvertSurfaceFormat(lpSurface, SDL_PIXELFORMAT_ABGR8888, 0);
+	SDL_FreeSurface(lpSurface);
+	return lpConverted;
+}
+
+//------------------------------------------------------------------------------
+
+bool Platform::isKeyHeld(int lKeyCode)
+{
+	// SDL2's keyboard state is indexed by scan code
+	const Uint8* lpKeysHeld = SDL_GetKeyboardState(nullptr);
+	return lpKeysHeld[SDL_GetScancodeFromKey(lKeyCode)] != 0;
+}
+
+//------------------------------------------------------------------------------
+
+std::string Platform::getFontFileName(const std::string& lrFace)
+{
+	return "data/" + lrFace + ".ttf";
+}
+
+//------------------------------------------------------------------------------
+
+void Platform::pageToggleMusic()		{ sMusicEnabled = !sMusicEnabled; }
+bool Platform::pageIsMusicEnabled()		{ return sMusicEnabled; }
+void Platform::pageToggleDebug()		{ sDebugEnabled = !sDebugEnabled; }
+bool Platform::pageIsDebugEnabled()		{ return sDebugEnabled; }
+
+#endif	// PLATFORM_NATIVE
+
+//------------------------------------------------------------------------------
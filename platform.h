@@ -0,0 +1,72 @@
+//------------------------------------------------------------------------------
+// Platform: Wraps the services that differ between the Emscripten (browser)
+//           build and the native (Linux/SDL2) build - the main loop, the clock,
+//           the window and the page elements around the canvas.
+//
+// The native backend is selected by defining PLATFORM_NATIVE, which the
+// Makefile's native target does.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <string>
+
+//------------------------------------------------------------------------------
+
+struct SDL_Surface;
+
+//------------------------------------------------------------------------------
+
+namespace Platform
+{
+	typedef void (*MainLoopFn)();
+	
+	// On Emscripten, this returns immediately and the browser calls the function once per frame.  On native builds,
+	// this blocks and calls the function repeatedly until cancelMainLoop() is called.
+	void runMainLoop(MainLoopFn lpLoopFunc);
+	void cancelMainLoop();
+	
+	// Frame pacing.  Where the platform can't block (the browser), it is told the rate instead and sleepUntil() does
+	// nothing.  A rate of zero means once per display refresh.
+	void setMainLoopRate(float lFPS);
+	bool canSleep();
+	// In getTimeMS() terms.  Precise sleeps spin for the last moment rather than risk overshooting; the rest just sleep,
+	// and may wake a little late.
+	void sleepUntil(double lTimeMS, bool lPrecise);
+	
+	double getTimeMS();		// milliseconds since an arbitrary fixed point; only differences are meaningful
+	double getThreadCPUTimeMS();	// CPU time used by the calling thread alone, in the same terms
+	
+	// Threads that can be used alongside the main thread; zero where there are none (the browser)
+	int numWorkerThreads();
+	
+	// Window and rendering surface
+	bool openWindow(int lWidth, int lHeight);
+	void closeWindow();
+	void swapBuffers();
+	SDL_Surface* getDisplaySurface();	// may be null on platforms where there isn't one
+	bool isWindowVisible();				// false if hidden or minimised
+	
+	// Takes ownership of the surface and returns one with RGBA byte order, as expected by glTexImage2D.  This may be
+	// the same surface.
+	SDL_Surface* convertSurfaceForGL(SDL_Surface* lpSurface);
+	
+	// Keyboard; takes an SDLK_* key code
+	bool isKeyHeld(int lKeyCode);
+	
+	// Converts a font face name from the settings into a name that can be opened with TTF_OpenFont
+	std::string getFontFileName(const std::string& lrFace);
+	
+	// Page elements (the check boxes around the canvas).  Native builds keep the equivalent state internally.
+	void pageToggleMusic();
+	bool pageIsMusicEnabled();
+	void pageToggleDebug();
+	bool pageIsDebugEnabled();
+}
+
+//------------------------------------------------------------------------------
+
+#endif // PLATFORM_H
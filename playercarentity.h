@@ -14,15 +14,16 @@
 class PlayerCarEntity : public CarEntity
 {
 public:
-	PlayerCarEntity(float lX, float lY);
+	PlayerCarEntity(World* lpWorld, float lX, float lY);
 	
-	virtual const char* type() const { return "player"; }
+	static constexpr const char* kType = "player";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	virtual void update(float lTimeDeltaSec);
 };
 
-extern PlayerCarEntity* gpPlayer;
-
 //------------------------------------------------------------------------------
 
 #endif // PLAYERCARENTITY_H
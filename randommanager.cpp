@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+// RandomManager: Seedable random numbers for all gameplay randomness.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "randommanager.h"
+
+#include "platform.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "useful.h"
+#include <cstdio>
+#include <ctime>
+
+//------------------------------------------------------------------------------
+// RandomStream
+//------------------------------------------------------------------------------
+
+RandomStream::RandomStream()
+{
+	seed(0, 0);
+}
+
+//------------------------------------------------------------------------------
+
+void RandomStream::seed(uint64_t lSeed, uint64_t lSequence)
+{
+	// Standard PCG32 seeding procedure
+	mState = 0;
+	mIncrement = (lSequence << 1) | 1;
+	getU32();
+	mState += lSeed;
+	getU32();
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t RandomStream::getU32()
+{
+	uint64_t lOldState = mState;
+	mState = lOldState * 6364136223846793005ULL + mIncrement;
+	uint32_t lXorShifted = uint32_t(((lOldState >> 18) ^ lOldState) >> 27);
+	uint32_t lRotation = uint32_t(lOldState >> 59);
+	return (lXorShifted >> lRotation) | (lXorShifted << ((32 - lRotation) & 31));
+}
+
+//------------------------------------------------------------------------------
+
+float RandomStream::getFloat()
+{
+	// Use the top 24 bits, which is all a float can hold exactly, so the result is always < 1
+	return float(getU32() >> 8) * (1.0f / 16777216.0f);
+}
+
+//------------------------------------------------------------------------------
+
+int RandomStream::getInt(int lMaxExclusive)
+{
+	if (lMaxExclusive <= 1)
+		return 0;
+	// The bias from the modulo is negligible for the small ranges used in the game
+	return int(getU32() % uint32_t(lMaxExclusive));
+}
+
+//------------------------------------------------------------------------------
+
+void RandomStream::saveState(SnapshotWriter& lrWriter) const
+{
+	lrWriter.write(mState);
+	lrWriter.write(mIncrement);
+}
+
+//------------------------------------------------------------------------------
+
+void RandomStream::loadState(SnapshotReader& lrReader)
+{
+	lrReader.read(&mState);
+	lrReader.read(&mIncrement);
+}
+
+//------------------------------------------------------------------------------
+// RandomManager
+//------------------------------------------------------------------------------
+
+RandomManager::RandomManager() :
+	mSeed(0)
+{
+	seed(0);
+}
+
+//------------------------------------------------------------------------------
+
+void RandomManager::seed(uint32_t lSeed)
+{
+	mSeed = lSeed;
+	for (int lStream = 0; lStream < kNumStreams; ++lStream)
+		mStreams[lStream].seed(lSeed, uint64_t(lStream));
+}
+
+//------------------------------------------------------------------------------
+
+void RandomManager::saveState(SnapshotWriter& lrWriter) const
+{
+	lrWriter.write(mSeed);
+	for (const RandomStream& lrStream: mStreams)
+		lrStream.saveState(lrWriter);
+}
+
+//------------------------------------------------------------------------------
+
+void RandomManager::loadState(SnapshotReader& lrReader)
+{
+	lrReader.read(&mSeed);
+	for (RandomStream& lrStream: mStreams)
+		lrStream.loadState(lrReader);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t RandomManager::chooseSeed(const std::string& lrArgValue)
+{
+	uint32_t lSeed = uint32_t(strtoul(lrArgValue.c_str(), nullptr, 10));
+	if (lSeed == 0)
+		lSeed = uint32_t(strtoul(Settings::getString("general/random_seed").c_str(), nullptr, 10));
+	if (lSeed == 0)
+	{
+		lSeed = uint32_t(time(nullptr)) ^ uint32_t(Platform::getTimeMS() * 1000.0);
+		if (lSeed == 0)
+			lSeed = 1;
+	}
+	printf("Random seed: %u\n", lSeed);
+	return lSeed;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------------
+// RandomManager: Seedable random numbers for all gameplay randomness.
+//
+// Each subsystem draws from its own stream, so adding or removing random calls
+// in one subsystem doesn't shift the numbers seen by the others.  The same
+// seed always produces the same sequences, on every platform.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef RANDOMMANAGER_H
+#define RANDOMMANAGER_H
+
+#include <cstdint>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+class SnapshotReader;
+class SnapshotWriter;
+
+//------------------------------------------------------------------------------
+
+// A small, fast generator (PCG32: a 64-bit LCG with a permuted 32-bit output)
+class RandomStream
+{
+public:
+	RandomStream();
+	
+	void seed(uint64_t lSeed, uint64_t lSequence);	// different sequence values give independent streams
+	
+	uint32_t getU32();
+	float getFloat();							// [0, 1)
+	int getInt(int lMaxExclusive);				// [0, lMaxExclusive)
+	
+	void saveState(SnapshotWriter& lrWriter) const;
+	void loadState(SnapshotReader& lrReader);
+	
+private:
+	uint64_t mState;
+	uint64_t mIncrement;						// must be odd
+};
+
+//------------------------------------------------------------------------------
+
+class RandomManager
+{
+public:
+	enum Stream
+	{
+		kLevelStream,			// level layout and appearance
+		kPassengerStream,		// passenger destinations
+		kSoundStream,			// sound variations
+		kNumStreams
+	};
+	
+	RandomManager();
+	
+	void seed(uint32_t lSeed);
+	uint32_t currentSeed() const { return mSeed; }
+	
+	// Picks a seed from the command line argument value, or the settings if that's empty.  Zero in either means
+	// choose one from the clock.
+	static uint32_t chooseSeed(const std::string& lrArgValue);
+	
+	RandomStream& stream(Stream lStream) { return mStreams[lStream]; }
+	float getFloat(Stream lStream) { return mStreams[lStream].getFloat(); }
+	int getInt(Stream lStream, int lMaxExclusive) { return mStreams[lStream].getInt(lMaxExclusive); }
+	
+	void saveState(SnapshotWriter& lrWriter) const;
+	void loadState(SnapshotReader& lrReader);
+	
+private:
+	uint32_t mSeed;
+	RandomStream mStreams[kNumStreams];
+};
+
+//------------------------------------------------------------------------------
+
+#endif // RANDOMMANAGER_H
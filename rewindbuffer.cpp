@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+// RewindBuffer: A ring buffer of recent snapshots, one per simulation step,
+//               mostly stored as deltas so that many seconds fit cheaply.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "rewindbuffer.h"
+
+#include "snapshot.h"
+#include "useful.h"
+
+//------------------------------------------------------------------------------
+
+RewindBuffer::RewindBuffer(int lCapacity, int lKeyframeInterval) :
+	mEntries(size_t(max(lCapacity, 1))),
+	mNewest(-1),
+	mCount(0),
+	mKeyframeInterval(max(lKeyframeInterval, 1))
+{
+}
+
+//------------------------------------------------------------------------------
+
+void RewindBuffer::clear()
+{
+	mNewest = -1;
+	mCount = 0;
+}
+
+//------------------------------------------------------------------------------
+
+int RewindBuffer::indexFromNewest(int lStepsBack) const
+{
+	int lNumEntries = int(mEntries.size());
+	return (mNewest - lStepsBack + lNumEntries) % lNumEntries;
+}
+
+//------------------------------------------------------------------------------
+
+int RewindBuffer::newestKeyframeDistance() const
+{
+	// The oldest snapshot is always a keyframe, so this always finds one
+	for (int lStepsBack = 0; lStepsBack < mCount; ++lStepsBack)
+		if (mEntries[indexFromNewest(lStepsBack)].mKeyframe)
+			return lStepsBack;
+	ASSERT(false);
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void RewindBuffer::push(const std::vector<uint8_t>& lrSnapshot)
+{
+	bool lKeyframe = mCount == 0 || newestKeyframeDistance() + 1 >= mKeyframeInterval;
+	const std::vector<uint8_t>* lpKeyframe = lKeyframe ? nullptr
+														: &mEntries[indexFromNewest(newestKeyframeDistance())].mData;
+	
+	int lNumEntries = int(mEntries.size());
+	if (lpKeyframe != nullptr && mCount == lNumEntries && lpKeyframe == &mEntries[indexFromNewest(mCount - 1)].mData)
+		lKeyframe = true;		// the keyframe is about to be overwritten
+	
+	mNewest = (mNewest + 1) % lNumEntries;
+	mCount = min(mCount + 1, lNumEntries);
+	Entry& lrEntry = mEntries[mNewest];
+	lrEntry.mKeyframe = lKeyframe;
+	if (lKeyframe)
+		lrEntry.mData = lrSnapshot;
+	else
+		encodeSnapshotDelta(*lpKeyframe, lrSnapshot, &lrEntry.mData);
+	
+	// Deltas whose keyframe has been overwritten are no use, so drop them from the old end
+	while (mCount > 1 && !mEntries[indexFromNewest(mCount - 1)].mKeyframe)
+		--mCount;
+}
+
+//------------------------------------------------------------------------------
+
+bool RewindBuffer::pop(std::vector<uint8_t>* lpSnapshotOut)
+{
+	if (mCount == 0)
+		return false;
+	
+	const Entry& lrEntry = mEntries[mNewest];
+	bool lSucceeded = true;
+	if (lrEntry.mKeyframe)
+		*lpSnapshotOut = lrEntry.mData;
+	else
+	{
+		const Entry& lrKeyframe = mEntries[indexFromNewest(newestKeyframeDistance())];
+		lSucceeded = decodeSnapshotDelta(lrKeyframe.mData, lrEntry.mData, lpSnapshotOut);
+	}
+	
+	mNewest = indexFromNewest(1);
+	--mCount;
+	return lSucceeded;
+}
+
+//------------------------------------------------------------------------------
+
+size_t RewindBuffer::numBytesStored() const
+{
+	size_t lNumBytes = 0;
+	for (int lStepsBack = 0; lStepsBack < mCount; ++lStepsBack)
+		lNumBytes += mEntries[indexFromNewest(lStepsBack)].mData.size();
+	return lNumBytes;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,47 @@
+//------------------------------------------------------------------------------
+// RewindBuffer: A ring buffer of recent snapshots, one per simulation step,
+//               mostly stored as deltas so that many seconds fit cheaply.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef REWINDBUFFER_H
+#define REWINDBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class RewindBuffer
+{
+public:
+	// Every lKeyframeInterval-th snapshot is stored whole, and the others as deltas against the last whole one
+	RewindBuffer(int lCapacity, int lKeyframeInterval);
+	
+	void clear();
+	void push(const std::vector<uint8_t>& lrSnapshot);
+	bool pop(std::vector<uint8_t>* lpSnapshotOut);		// takes the newest; returns false if there are none
+	
+	int numSnapshots() const { return mCount; }
+	size_t numBytesStored() const;
+	
+private:
+	int indexFromNewest(int lStepsBack) const;
+	int newestKeyframeDistance() const;		// steps back from the newest snapshot to its keyframe
+	
+	struct Entry
+	{
+		std::vector<uint8_t> mData;			// buffers are reused as the ring wraps, so there's no allocation once full
+		bool mKeyframe;
+	};
+	std::vector<Entry> mEntries;
+	int mNewest;
+	int mCount;
+	int mKeyframeInterval;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // REWINDBUFFER_H
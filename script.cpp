@@ -0,0 +1,129 @@
+//------------------------------------------------------------------------------
+// Script: Gameplay sequences written as one function that waits part way
+//         through and carries on where it left off, and the scheduler that
+//         wakes them up from a timer wheel.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "script.h"
+
+#include "snapshot.h"
+#include "useful.h"
+
+//------------------------------------------------------------------------------
+
+Script::Script() :
+	mpScheduler(nullptr),
+	mIndex(0),
+	mResumePoint(kStopped)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void Script::start()
+{
+	stop();
+	mResumePoint = 0;
+	run();
+}
+
+//------------------------------------------------------------------------------
+
+void Script::stop()
+{
+	ASSERT2(mpScheduler != nullptr, "script not added to a scheduler");
+	mpScheduler->mWheel.cancel(mTimer);
+	mTimer = TimerHandle();
+	mResumePoint = kStopped;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t Script::ticksLeft() const
+{
+	return mpScheduler != nullptr ? mpScheduler->mWheel.ticksLeft(mTimer) : 0;
+}
+
+//------------------------------------------------------------------------------
+
+void Script::waitSec(float lSec, int lResumePoint)
+{
+	ASSERT2(mpScheduler != nullptr, "script not added to a scheduler");
+	mResumePoint = lResumePoint;
+	mTimer = mpScheduler->mWheel.add(mpScheduler->ticksFromSec(lSec), mIndex);
+}
+
+//------------------------------------------------------------------------------
+
+ScriptScheduler::ScriptScheduler(float lTickSec) :
+	mTickSec(lTickSec)
+{
+}
+
+//------------------------------------------------------------------------------
+
+void ScriptScheduler::add(Script* lpScript)
+{
+	ASSERT(lpScript->mpScheduler == nullptr);
+	lpScript->mpScheduler = this;
+	lpScript->mIndex = uint32_t(mScripts.size());
+	mScripts.push_back(lpScript);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t ScriptScheduler::ticksFromSec(float lSec) const
+{
+	// Rounded, so that e.g. ten seconds is exactly 600 ticks at 60Hz, and never less than a tick
+	return uint32_t(max(lSec / mTickSec + 0.5f, 1.0f));
+}
+
+//------------------------------------------------------------------------------
+
+void ScriptScheduler::advance()
+{
+	mWheel.advance(&mFired);
+	for (const TimerWheel::Fired& lrFired: mFired)
+	{
+		// A script resumed earlier in the tick might have stopped or restarted this one
+		Script* lpScript = mScripts[lrFired.mPayload];
+		if (lpScript->mTimer != lrFired.mTimer)
+			continue;
+		lpScript->mTimer = TimerHandle();
+		lpScript->run();
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void ScriptScheduler::saveState(SnapshotWriter& lrWriter) const
+{
+	mWheel.saveState(lrWriter);
+	for (const Script* lpScript: mScripts)
+	{
+		lrWriter.write(int32_t(lpScript->mResumePoint));
+		lrWriter.write(lpScript->mTimer.value());
+		lpScript->saveState(lrWriter);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void ScriptScheduler::loadState(SnapshotReader& lrReader)
+{
+	mWheel.loadState(lrReader);
+	for (Script* lpScript: mScripts)
+	{
+		int32_t lResumePoint;
+		uint32_t lTimer;
+		lrReader.read(&lResumePoint);
+		lrReader.read(&lTimer);
+		lpScript->mResumePoint = lResumePoint;
+		lpScript->mTimer = TimerHandle::fromValue(lTimer);
+		lpScript->loadState(lrReader);
+	}
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,110 @@
+//------------------------------------------------------------------------------
+// Script: Gameplay sequences written as one function that waits part way
+//         through and carries on where it left off, and the scheduler that
+//         wakes them up from a timer wheel.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include "timerwheel.h"
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class ScriptScheduler;
+class SnapshotReader;
+class SnapshotWriter;
+
+//------------------------------------------------------------------------------
+
+// The body goes in run(), between SCRIPT_BEGIN() and SCRIPT_END(), with SCRIPT_WAIT_SEC() wherever it waits:
+//
+//		void run()
+//		{
+//			SCRIPT_BEGIN();
+//			SCRIPT_WAIT_SEC(10.0f);
+//			mpWorld->losePassenger();
+//			SCRIPT_END();
+//		}
+//
+// Each wait returns from run(), and the next call jumps back to just after it.  So local variables don't last across
+// a wait: anything that needs to should be a member, and saved in saveState() so that snapshots bring it back.  Only
+// one wait can go on each line, and none can go inside a switch of the script's own.
+class Script
+{
+public:
+	Script();
+	virtual ~Script() {}
+	
+	bool isRunning() const { return mResumePoint != kStopped; }
+	
+	// Starting runs the body straight away up to its first wait, from the top even if it's already running
+	void start();
+	void stop();
+	uint32_t ticksLeft() const;		// in the current wait
+	
+	// For members that last across waits; the scheduler saves where the script is up to
+	virtual void saveState(SnapshotWriter& lrWriter) const {}
+	virtual void loadState(SnapshotReader& lrReader) {}
+	
+protected:
+	virtual void run() = 0;
+	
+	int resumePoint() const { return mResumePoint; }
+	void waitSec(float lSec, int lResumePoint);
+	void finish() { mResumePoint = kStopped; }
+	
+private:
+	friend class ScriptScheduler;
+	
+	static const int kStopped = -1;
+	
+	ScriptScheduler* mpScheduler;
+	uint32_t mIndex;			// in the scheduler, which is what the timers carry
+	int mResumePoint;
+	TimerHandle mTimer;
+};
+
+#define SCRIPT_BEGIN()			switch (resumePoint()) { case 0:
+#define SCRIPT_WAIT_SEC(lSec)	do { waitSec(lSec, __LINE__); return; case __LINE__:; } while (false)
+#define SCRIPT_END()			} finish()
+
+//------------------------------------------------------------------------------
+
+// Runs on simulation steps: each advance() is one tick, and waits are rounded to whole ticks.  Resuming costs the same
+// however many scripts are waiting, as only the timers due that tick are looked at.
+class ScriptScheduler
+{
+public:
+	ScriptScheduler(float lTickSec);
+	
+	// The scripts aren't owned.  They're added once, when the owner's set up, so that snapshots can find them again.
+	void add(Script* lpScript);
+	
+	uint32_t now() const { return mWheel.now(); }
+	uint32_t ticksFromSec(float lSec) const;
+	float tickSec() const { return mTickSec; }
+	
+	// Resumes the scripts whose waits are up, in the order they started waiting
+	void advance();
+	
+	void saveState(SnapshotWriter& lrWriter) const;
+	void loadState(SnapshotReader& lrReader);
+	
+private:
+	friend class Script;
+	
+	float mTickSec;
+	TimerWheel mWheel;
+	std::vector<Script*> mScripts;
+	std::vector<TimerWheel::Fired> mFired;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // SCRIPT_H
@@ -65,7 +65,7 @@ namespace
 		mpCurrentGroup = lpDefaultGroup;
 		mGroupMap[mCurrentGroupName] = mpCurrentGroup;
 		
-		char lLineBuf[256];
+		char lLineBuf[1024];
 		while (!lSrc.eof())
 		{
 			lSrc.getline(lLineBuf, sizeof(lLineBuf));
@@ -310,3 +310,10 @@ bool Settings::setGroup(const std::string& lrName)
 }
 
 //------------------------------------------------------------------------------
+
+void Settings::load()
+{
+	SettingsManager::instance();
+}
+
+//------------------------------------------------------------------------------
@@ -26,6 +26,10 @@ namespace Settings
 	std::vector<std::string> getStringVector(const std::string& lrName);
 	
 	bool setGroup(const std::string& lrName);		// returns false (and traces) if the group does not exist
+	
+	// The file is otherwise read on first use.  Reading settings is then safe from any thread, although setGroup()
+	// isn't - use absolute names in anything that might run alongside other threads.
+	void load();
 }
 
 //------------------------------------------------------------------------------
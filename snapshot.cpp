@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+// snapshot: Reading and writing the simulation state as a compact binary blob,
+//           and delta compression of one blob against another.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "snapshot.h"
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	// A run of changed bytes only ends at this many unchanged ones, so that a stray matching byte in a changed
+	// float doesn't cost two run headers
+	const size_t kMinUnchangedRun = 4;
+	
+	//------------------------------------------------------------------------------
+	
+	void writeVarUint(std::vector<uint8_t>& lrBuf, size_t lVal)
+	{
+		// 7 bits per byte, with the top bit set on all but the last byte
+		while (lVal >= 0x80)
+		{
+			lrBuf.push_back(uint8_t(lVal & 0x7F) | 0x80);
+			lVal >>= 7;
+		}
+		lrBuf.push_back(uint8_t(lVal));
+	}
+	
+	bool readVarUint(const std::vector<uint8_t>& lrBuf, size_t* lpPos, size_t* lpValOut)
+	{
+		size_t lVal = 0;
+		for (int lShift = 0; lShift < 35; lShift += 7)
+		{
+			if (*lpPos >= lrBuf.size())
+				return false;
+			uint8_t lByte = lrBuf[(*lpPos)++];
+			lVal |= size_t(lByte & 0x7F) << lShift;
+			if ((lByte & 0x80) == 0)
+			{
+				*lpValOut = lVal;
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+//------------------------------------------------------------------------------
+// SnapshotWriter / SnapshotReader
+//------------------------------------------------------------------------------
+
+void SnapshotWriter::writeString(const std::string& lrString)
+{
+	write(uint32_t(lrString.size()));
+	mpBuf->insert(mpBuf->end(), lrString.begin(), lrString.end());
+}
+
+//------------------------------------------------------------------------------
+
+void SnapshotReader::readString(std::string* lpStringOut)
+{
+	uint32_t lLength;
+	read(&lLength);
+	if (mPos + lLength > mrBuf.size())
+	{
+		mFailed = true;
+		lpStringOut->clear();
+		return;
+	}
+	lpStringOut->assign(reinterpret_cast<const char*>(mrBuf.data() + mPos), lLength);
+	mPos += lLength;
+}
+
+//------------------------------------------------------------------------------
+// Delta compression
+//------------------------------------------------------------------------------
+
+void encodeSnapshotDelta(const std::vector<uint8_t>& lrBase, const std::vector<uint8_t>& lrTarget,
+						 std::vector<uint8_t>* lpDeltaOut)
+{
+	// Format: the target size, then pairs of runs (unchanged length, changed length + the changed bytes) to the end.
+	// Anything beyond the end of the base counts as changed.
+	std::vector<uint8_t>& lrDelta = *lpDeltaOut;
+	lrDelta.clear();
+	writeVarUint(lrDelta, lrTarget.size());
+	
+	const size_t kTargetSize = lrTarget.size();
+	const size_t kCommonSize = lrBase.size() < kTargetSize ? lrBase.size() : kTargetSize;
+	auto lIsUnchanged = [&](size_t lPos) { return lPos < kCommonSize && lrBase[lPos] == lrTarget[lPos]; };
+	
+	size_t lPos = 0;
+	while (lPos < kTargetSize)
+	{
+		size_t lUnchangedStart = lPos;
+		while (lPos < kTargetSize && lIsUnchanged(lPos))
+			++lPos;
+		size_t lChangedStart = lPos;
+		while (lPos < kTargetSize)
+		{
+			if (!lIsUnchanged(lPos))
+			{
+				++lPos;
+				continue;
+			}
+			size_t lRunEnd = lPos;
+			while (lRunEnd < kTargetSize && lRunEnd - lPos < kMinUnchangedRun && lIsUnchanged(lRunEnd))
+				++lRunEnd;
+			if (lRunEnd - lPos >= kMinUnchangedRun || lRunEnd == kTargetSize)
+				break;
+			lPos = lRunEnd;
+		}
+		
+		writeVarUint(lrDelta, lChangedStart - lUnchangedStart);
+		writeVarUint(lrDelta, lPos - lChangedStart);
+		lrDelta.insert(lrDelta.end(), lrTarget.begin() + lChangedStart, lrTarget.begin() + lPos);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+bool decodeSnapshotDelta(const std::vector<uint8_t>& lrBase, const std::vector<uint8_t>& lrDelta,
+						 std::vector<uint8_t>* lpTargetOut)
+{
+	std::vector<uint8_t>& lrTarget = *lpTargetOut;
+	size_t lDeltaPos = 0;
+	size_t lTargetSize;
+	if (!readVarUint(lrDelta, &lDeltaPos, &lTargetSize))
+		return false;
+	lrTarget.resize(lTargetSize);
+	
+	size_t lPos = 0;
+	while (lPos < lTargetSize)
+	{
+		size_t lUnchanged, lChanged;
+		if (!readVarUint(lrDelta, &lDeltaPos, &lUnchanged) || !readVarUint(lrDelta, &lDeltaPos, &lChanged))
+			return false;
+		if (lPos + lUnchanged > lrBase.size() || lPos + lUnchanged + lChanged > lTargetSize
+			|| lDeltaPos + lChanged > lrDelta.size())
+			return false;
+		
+		memcpy(lrTarget.data() + lPos, lrBase.data() + lPos, lUnchanged);
+		lPos += lUnchanged;
+		memcpy(lrTarget.data() + lPos, lrDelta.data() + lDeltaPos, lChanged);
+		lPos += lChanged;
+		lDeltaPos += lChanged;
+	}
+	return lDeltaPos == lrDelta.size();
+}
+
+//------------------------------------------------------------------------------
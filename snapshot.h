@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------
+// snapshot: Reading and writing the simulation state as a compact binary blob,
+//           and delta compression of one blob against another.
+//
+// Snapshots are for use within one run (rewind, retry, etc.): values are
+// stored in the machine's own format, and there's no versioning.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(std::vector<uint8_t>* lpBuf) : mpBuf(lpBuf) {}
+	
+	template <typename Type> void write(Type lVal)
+	{
+		static_assert(std::is_arithmetic<Type>::value, "Only plain values can be written directly");
+		size_t lPos = mpBuf->size();
+		mpBuf->resize(lPos + sizeof(Type));
+		memcpy(mpBuf->data() + lPos, &lVal, sizeof(Type));
+	}
+	void writeString(const std::string& lrString);
+	
+private:
+	std::vector<uint8_t>* mpBuf;
+};
+
+//------------------------------------------------------------------------------
+
+// Reading past the end sets a failure flag and gives zeros, so the caller only has to check once at the end
+class SnapshotReader
+{
+public:
+	SnapshotReader(const std::vector<uint8_t>& lrBuf) : mrBuf(lrBuf), mPos(0), mFailed(false) {}
+	
+	template <typename Type> void read(Type* lpValOut)
+	{
+		static_assert(std::is_arithmetic<Type>::value, "Only plain values can be read directly");
+		if (mPos + sizeof(Type) > mrBuf.size())
+		{
+			mFailed = true;
+			*lpValOut = Type(0);
+			return;
+		}
+		memcpy(lpValOut, mrBuf.data() + mPos, sizeof(Type));
+		mPos += sizeof(Type);
+	}
+	void readString(std::string* lpStringOut);
+	
+	bool failed() const { return mFailed; }
+	bool atEnd() const { return mPos == mrBuf.size(); }
+	
+private:
+	const std::vector<uint8_t>& mrBuf;
+	size_t mPos;
+	bool mFailed;
+};
+
+//------------------------------------------------------------------------------
+
+// The delta is a list of runs: bytes unchanged from the base, then bytes to copy from the delta.  Snapshots of
+// consecutive steps differ only in the entities that moved, so the delta is usually a small fraction of the size.
+void encodeSnapshotDelta(const std::vector<uint8_t>& lrBase, const std::vector<uint8_t>& lrTarget,
+						 std::vector<uint8_t>* lpDeltaOut);
+bool decodeSnapshotDelta(const std::vector<uint8_t>& lrBase, const std::vector<uint8_t>& lrDelta,
+						 std::vector<uint8_t>* lpTargetOut);		// returns false if the delta is corrupt
+
+//------------------------------------------------------------------------------
+
+#endif // SNAPSHOT_H
@@ -6,12 +6,14 @@
 
 #include "spriteentity.h"
 
-#include "app.h"
 #include "camera.h"
 #include "settings.h"
+#include "snapshot.h"
+#include "statehash.h"
 #include "texturemanager.h"
 #include "useful.h"
 #include "video.h"
+#include "world.h"
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
@@ -47,20 +49,43 @@ static const glm::vec3 kZAxis(0.0f, 0.0f, 1.0f);
 
 //------------------------------------------------------------------------------
 
-SpriteEntity::SpriteEntity(float lX, float lY) :
-	Entity(lX, lY),
-	mpTexture(nullptr),
-	mRotationRad(0.0f),
-	mRotationStartsFromUp(false),
-	mBlendEnabled(true),
-	mBehindCamera(false),
-	mVisible(true)
+SpriteEntity::SpriteEntity(World* lpWorld, float lX, float lY) :
+	Entity(lpWorld, lX, lY),
+	mSpriteIndex(-1)
 {
-	for (int lIndex = 0; lIndex < sizeof(mColour) / sizeof(float); ++lIndex)
-		mColour[lIndex] = 1.0f;
-	
-	if (!msStaticInitDone)
-		staticInit();
+	addSprite();
+}
+
+//------------------------------------------------------------------------------
+
+SpriteEntity::SpriteEntity(ComponentStore& lrComponents, float lX, float lY) :
+	Entity(lrComponents, lX, lY),
+	mSpriteIndex(-1)
+{
+	addSprite();
+}
+
+//------------------------------------------------------------------------------
+
+void SpriteEntity::addSprite()
+{
+	Sprite lSprite = { nullptr, 0.0f, 0.0f, { 1.0f, 1.0f, 1.0f, 1.0f }, false, true, false, true };
+	components().sprites().add(&mSpriteIndex, lSprite);
+}
+
+//------------------------------------------------------------------------------
+
+SpriteEntity::~SpriteEntity()
+{
+	components().sprites().remove(mSpriteIndex);
+}
+
+//------------------------------------------------------------------------------
+
+void SpriteEntity::setComponentsActive(bool lActive)
+{
+	Entity::setComponentsActive(lActive);
+	components().sprites().setActive(mSpriteIndex, lActive);
 }
 
 //------------------------------------------------------------------------------
@@ -107,33 +132,77 @@ void SpriteEntity::staticInit()
 
 void SpriteEntity::setTexture(Texture* lpTexture)
 {
-	mpTexture = lpTexture;
-	setWidth(float(mpTexture->width()));
-	setHeight(float(mpTexture->height()));
+	sprite().mpTexture = lpTexture;
+	setWidth(float(lpTexture->width()));
+	setHeight(float(lpTexture->height()));
+}
+
+//------------------------------------------------------------------------------
+
+void SpriteEntity::saveState(SnapshotWriter& lrWriter) const
+{
+	Entity::saveState(lrWriter);
+	const Sprite& lrSprite = sprite();
+	lrWriter.write(lrSprite.mRotationRad);
+	lrWriter.write(lrSprite.mPrevRotationRad);
+	lrWriter.write(uint8_t(lrSprite.mVisible));
+}
+
+//------------------------------------------------------------------------------
+
+void SpriteEntity::loadState(SnapshotReader& lrReader)
+{
+	Entity::loadState(lrReader);
+	Sprite& lrSprite = sprite();
+	lrReader.read(&lrSprite.mRotationRad);
+	lrReader.read(&lrSprite.mPrevRotationRad);
+	uint8_t lVisible;
+	lrReader.read(&lVisible);
+	lrSprite.mVisible = lVisible != 0;
+}
+
+//------------------------------------------------------------------------------
+
+void SpriteEntity::addToHash(StateHash& lrHash) const
+{
+	Entity::addToHash(lrHash);
+	lrHash.add(sprite().mRotationRad);
 }
 
 //------------------------------------------------------------------------------
 
 void SpriteEntity::render() const
 {
-	if (!mVisible)
+	render(sprite().mBehindCamera ? nullptr : &world()->camera());
+}
+
+//------------------------------------------------------------------------------
+
+void SpriteEntity::render(const Camera* lpCamera) const
+{
+	const Sprite& lrSprite = sprite();
+	if (!lrSprite.mVisible)
 		return;
 	
 	Entity::render();
 	
+	// The GL resources are set up on first use, so sprites can be simulated without any video (e.g. in headless mode)
+	if (!msStaticInitDone)
+		staticInit();
 	if (msShaderProg == 0)
 		return;
 	glUseProgram(msShaderProg);
 	
-	float lAdjustedX = x();
-	float lAdjustedY = y();
-	if (!mBehindCamera)
+	float lAdjustedX = renderX();
+	float lAdjustedY = renderY();
+	if (!lrSprite.mBehindCamera)
 	{
-		if (!gpCamera->canSee(this))
+		ASSERT(lpCamera != nullptr);
+		if (!lpCamera->canSee(this))
 			return;
 		
-		lAdjustedX -= gpCamera->offsetX();
-		lAdjustedY -= gpCamera->offsetY();
+		lAdjustedX -= lpCamera->renderOffsetX();
+		lAdjustedY -= lpCamera->renderOffsetY();
 	}
 	
 	// Set up the transformation matrix
@@ -142,14 +211,14 @@ void SpriteEntity::render() const
 	lTransform = glm::translate(lTransform, glm::vec3(lAdjustedX * msScreenScaleX - 1.0f,
 													  lAdjustedY * msScreenScaleY + 1.0f, 0.0f));
 	lTransform = glm::scale(lTransform, glm::vec3(width() * msScreenScaleX, height() * msScreenScaleY, 1.0f));
-	lTransform = glm::rotate(lTransform, fixedRotationRad(), kZAxis);
+	lTransform = glm::rotate(lTransform, renderRotationRad(), kZAxis);
 	glUniformMatrix4fv(msMatUniformID, 1, GL_FALSE, &lTransform[0][0]);
 	
 	// Colour
-	glUniform4fv(msColUniformID, 1, mColour);
+	glUniform4fv(msColUniformID, 1, lrSprite.mColour);
 	
 	// Texture
-	mpTexture->activate();
+	lrSprite.mpTexture->activate();
 	glUniform1i(msTexUniformID, 0);
 	
 	// Set up the positions
@@ -163,7 +232,7 @@ void SpriteEntity::render() const
 	glEnableVertexAttribArray(msUVAttributeID);
 	
 	// Blending
-	if (mBlendEnabled)
+	if (lrSprite.mBlendEnabled)
 	{
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -181,19 +250,44 @@ void SpriteEntity::render() const
 
 float SpriteEntity::fixedRotationRad() const
 {
-	return mRotationStartsFromUp ? (-M_PI_OVER_2 - mRotationRad) : mRotationRad;
+	const Sprite& lrSprite = sprite();
+	return lrSprite.mRotationStartsFromUp ? (-M_PI_OVER_2 - lrSprite.mRotationRad) : lrSprite.mRotationRad;
+}
+
+//------------------------------------------------------------------------------
+
+float SpriteEntity::renderRotationRad() const
+{
+	const Sprite& lrSprite = sprite();
+	float lRotationRad = lrSprite.mPrevRotationRad + (lrSprite.mRotationRad - lrSprite.mPrevRotationRad) * msRenderInterp;
+	return lrSprite.mRotationStartsFromUp ? (-M_PI_OVER_2 - lRotationRad) : lRotationRad;
 }
 
 //------------------------------------------------------------------------------
 // CollidableEntity
 //------------------------------------------------------------------------------
 
-CollidableEntity::CollidableEntity(float lX, float lY) :
-	SpriteEntity(lX, lY),
-	mUsesCircleCollisions(false),
-	mCollisionTriggersEvent(false),
-	mSoundDelaySec(0.0f)
+CollidableEntity::CollidableEntity(World* lpWorld, float lX, float lY) :
+	SpriteEntity(lpWorld, lX, lY),
+	mColliderIndex(-1)
 {
+	Collider lCollider = { false, false, 0 };
+	components().colliders().add(&mColliderIndex, lCollider);
+}
+
+//------------------------------------------------------------------------------
+
+CollidableEntity::~CollidableEntity()
+{
+	components().colliders().remove(mColliderIndex);
+}
+
+//------------------------------------------------------------------------------
+
+void CollidableEntity::setComponentsActive(bool lActive)
+{
+	SpriteEntity::setComponentsActive(lActive);
+	components().colliders().setActive(mColliderIndex, lActive);
 }
 
 //------------------------------------------------------------------------------
@@ -223,7 +317,8 @@ float CollidableEntity::bounceFactor() const
 bool CollidableEntity::checkCollisionWith(CollidableEntity* lpOther)
 {
 	// For now, assume that we're colliding the player with a house
-	if (name().find("player") == std::string::npos)
+	static const Name kPlayerTag("player");
+	if (!hasTag(kPlayerTag))
 		return false;
 	
 	// If the other entity is too far away, just skip it
@@ -288,14 +383,18 @@ bool CollidableEntity::checkCollisionWith(CollidableEntity* lpOther)
 	
 	//printf("%s collided with %s\n", name().c_str(), lpOther->name().c_str());
 	
-	// Check if we should trigger an event instead of bouncing off
+	// Check if we should trigger an event instead of bouncing off.  Events change the world, so they wait until the
+	// update has finished.
 	if (lpOther->collisionTriggersEvent())
 	{
-		lpOther->triggerCollisionEvent();
+		world()->entities().commands().triggerCollisionEvent(lpOther->handle());
 		return true;
 	}
 	
-	if (mSoundDelaySec <= 0.0f)
+	// The quiet spell is a step to compare against rather than a timer, so nothing has to count it down
+	Collider& lrCollider = collider();
+	World* lpWorld = world();
+	if (lpWorld->numSteps() >= lrCollider.mQuietUntilStep)
 	{
 		static const float kCrashSoundThreshold = Settings::getFloat("sound/crash_sound_threshold");
 		static const float kCrashSoundDelaySec = Settings::getFloat("sound/crash_sound_delay_sec");
@@ -303,8 +402,8 @@ bool CollidableEntity::checkCollisionWith(CollidableEntity* lpOther)
 		float lVelMagSq = velX() * velX() + velY() * velY();
 		if (lVelMagSq >= kCrashSoundThreshold * kCrashSoundThreshold)
 		{
-			gApplication.playSound("crash", 9);
-			mSoundDelaySec = kCrashSoundDelaySec;
+			lpWorld->playSound("crash", 9);
+			lrCollider.mQuietUntilStep = lpWorld->numSteps() + lpWorld->scheduler().ticksFromSec(kCrashSoundDelaySec);
 		}
 	}
 	
@@ -396,12 +495,18 @@ bool CollidableEntity::checkCollisionWith(CollidableEntity* lpOther)
 
 //------------------------------------------------------------------------------
 
-void CollidableEntity::update(float lTimeDeltaSec)
+void CollidableEntity::saveState(SnapshotWriter& lrWriter) const
 {
-	if (mSoundDelaySec >= 0.0f)
-		mSoundDelaySec -= lTimeDeltaSec;
-	
-	SpriteEntity::update(lTimeDeltaSec);
+	SpriteEntity::saveState(lrWriter);
+	lrWriter.write(collider().mQuietUntilStep);
+}
+
+//------------------------------------------------------------------------------
+
+void CollidableEntity::loadState(SnapshotReader& lrReader)
+{
+	SpriteEntity::loadState(lrReader);
+	lrReader.read(&collider().mQuietUntilStep);
 }
 
 //------------------------------------------------------------------------------
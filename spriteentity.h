@@ -14,6 +14,7 @@
 
 //------------------------------------------------------------------------------
 
+class Camera;
 class Texture;
 
 //------------------------------------------------------------------------------
@@ -21,44 +22,55 @@ class Texture;
 class SpriteEntity : public Entity
 {
 public:
-	SpriteEntity(float lX, float lY);
+	SpriteEntity(World* lpWorld, float lX, float lY);
+	SpriteEntity(ComponentStore& lrComponents, float lX, float lY);
+	virtual ~SpriteEntity();
 	
-	virtual const char* type() const { return "sprite"; }
+	static constexpr const char* kType = "sprite";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
 	virtual void render() const;
+	void render(const Camera* lpCamera) const;		// the camera can be null if the sprite is behind it
+	virtual void savePreviousState() { Entity::savePreviousState(); Sprite& lrSprite = sprite(); lrSprite.mPrevRotationRad = lrSprite.mRotationRad; }
+	virtual void saveState(SnapshotWriter& lrWriter) const;
+	virtual void loadState(SnapshotReader& lrReader);
+	virtual void addToHash(StateHash& lrHash) const;
 	
 	void setTexture(Texture* lpTexture);
 	
-	uint32_t colour() const									{ return u32ColFromFloats(mColour); }
-	void setColour(uint32_t lColour)						{ getFloatColsFromU32(lColour, mColour); }
+	uint32_t colour() const									{ return u32ColFromFloats(sprite().mColour); }
+	void setColour(uint32_t lColour)						{ getFloatColsFromU32(lColour, sprite().mColour); }
 	void setColour(float lR, float lG, float lB)			{ setColour(1.0f, lR, lG, lB); }
-	void setColour(float lA, float lR, float lG, float lB)	{ mColour[0] = lA; mColour[1] = lR; mColour[2] = lG; mColour[3] = lB; }
+	void setColour(float lA, float lR, float lG, float lB)
+		{ float* lpColour = sprite().mColour; lpColour[0] = lA; lpColour[1] = lR; lpColour[2] = lG; lpColour[3] = lB; }
 	
-	float rotationRad() const								{ return mRotationRad; }
-	void setRotationRad(float lRotation)					{ mRotationRad = lRotation; }
+	float rotationRad() const								{ return sprite().mRotationRad; }
+	virtual void setRotationRad(float lRotation)			{ sprite().mRotationRad = lRotation; }
 	float fixedRotationRad() const;
+	float renderRotationRad() const;		// interpolated, and fixed up as with fixedRotationRad()
 	
-	void setBlendEnabled(bool lEnabled)						{ mBlendEnabled = lEnabled; }
-	void setBehindCamera(bool lBehind)						{ mBehindCamera = lBehind; }
+	void setBlendEnabled(bool lEnabled)						{ sprite().mBlendEnabled = lEnabled; }
+	void setBehindCamera(bool lBehind)						{ sprite().mBehindCamera = lBehind; }
 	
-	bool isVisible() const									{ return mVisible; }
-	void setVisible(bool lVisible)							{ mVisible = lVisible; }
+	bool isVisible() const									{ return sprite().mVisible; }
+	void setVisible(bool lVisible)							{ sprite().mVisible = lVisible; }
 	
 protected:
-	void setRotationStartsFromUp(bool lEnabled)				{ mRotationStartsFromUp = lEnabled; }	// for car sprite, etc
+	void setRotationStartsFromUp(bool lEnabled)				{ sprite().mRotationStartsFromUp = lEnabled; }	// for car sprite, etc
+	virtual void setComponentsActive(bool lActive);
+	
+	Sprite& sprite()				{ return components().sprites()[mSpriteIndex]; }
+	const Sprite& sprite() const	{ return components().sprites()[mSpriteIndex]; }
 	
 private:
 	
 	static void staticInit();
+	void addSprite();
 	
 	
-	Texture* mpTexture;
-	float mRotationRad;
-	float mColour[4];			// ARGB
-	bool mRotationStartsFromUp;
-	bool mBlendEnabled;
-	bool mBehindCamera;			// the sprite's position is only affected by camera movement if this is false
-	bool mVisible;
+	int mSpriteIndex;
 	
 	// All sprites are rendered using a common set of vertex positions and UVs, and a set shader programme
 	static bool msStaticInitDone;
@@ -77,29 +89,36 @@ private:
 class CollidableEntity : public SpriteEntity
 {
 public:
-	CollidableEntity(float lX, float lY);
+	CollidableEntity(World* lpWorld, float lX, float lY);
+	virtual ~CollidableEntity();
 	
-	virtual const char* type() const { return "collidable"; }
+	static constexpr const char* kType = "collidable";
+	static constexpr EntityTypeId kTypeId = entityTypeId(kType);
+	virtual const char* type() const { return kType; }
+	virtual EntityTypeId typeId() const { return kTypeId; }
 	
-	virtual void update(float lTimeDeltaSec);
+	virtual void saveState(SnapshotWriter& lrWriter) const;
+	virtual void loadState(SnapshotReader& lrReader);
 	
 	bool checkCollisionWith(CollidableEntity* lpOther);
-	bool usesCircleCollisions() const { return mUsesCircleCollisions; }
+	bool usesCircleCollisions() const { return collider().mUsesCircleCollisions; }
 	virtual float bounceFactor() const;
 	
-	bool collisionTriggersEvent() const { return mCollisionTriggersEvent; }
-	virtual void triggerCollisionEvent() {}
+	bool collisionTriggersEvent() const { return collider().mCollisionTriggersEvent; }
+	virtual void triggerCollisionEvent() {}		// after the update, so it's free to change the world
 	
 protected:
-	void setUsesCircleCollisions(bool lEnabled)				{ mUsesCircleCollisions = lEnabled; }
-	void setCollisionTriggersEvent(bool lTriggers)			{ mCollisionTriggersEvent = lTriggers; }
+	void setUsesCircleCollisions(bool lEnabled)				{ collider().mUsesCircleCollisions = lEnabled; }
+	void setCollisionTriggersEvent(bool lTriggers)			{ collider().mCollisionTriggersEvent = lTriggers; }
 	
+	virtual void setComponentsActive(bool lActive);
 	void getRotatedBoundingBox(float* lpLeftOut, float* lpTopOut, float* lpRightOut, float* lpBottomOut) const;
 	
+	Collider& collider()				{ return components().colliders()[mColliderIndex]; }
+	const Collider& collider() const	{ return components().colliders()[mColliderIndex]; }
+	
 private:
-	bool mUsesCircleCollisions;
-	bool mCollisionTriggersEvent;
-	float mSoundDelaySec;
+	int mColliderIndex;
 };
 
 //------------------------------------------------------------------------------
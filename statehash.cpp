@@ -0,0 +1,100 @@
+//------------------------------------------------------------------------------
+// statehash: A quick hash of the simulation state, to check that two runs (or
+//            two builds) play out identically, and logs of it for comparing.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "statehash.h"
+
+#include <cinttypes>
+
+//------------------------------------------------------------------------------
+
+HashLog::HashLog() :
+	mpFile(nullptr)
+{
+}
+
+//------------------------------------------------------------------------------
+
+HashLog::~HashLog()
+{
+	if (mpFile != nullptr)
+		fclose(mpFile);
+}
+
+//------------------------------------------------------------------------------
+
+bool HashLog::open(const std::string& lrFileName)
+{
+	mpFile = fopen(lrFileName.c_str(), "w");
+	if (mpFile == nullptr)
+	{
+		printf("Error opening \"%s\" to log state hashes\n", lrFileName.c_str());
+		return false;
+	}
+	printf("Logging state hashes to \"%s\"\n", lrFileName.c_str());
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+void HashLog::add(uint32_t lStep, uint64_t lHash)
+{
+	if (mpFile != nullptr)
+		fprintf(mpFile, "%u %016" PRIx64 "\n", lStep, lHash);
+}
+
+//------------------------------------------------------------------------------
+
+int HashLog::compare(const std::string& lrFileName1, const std::string& lrFileName2)
+{
+	FILE* lpFile1 = fopen(lrFileName1.c_str(), "r");
+	FILE* lpFile2 = fopen(lrFileName2.c_str(), "r");
+	if (lpFile1 == nullptr || lpFile2 == nullptr)
+	{
+		printf("Error opening \"%s\"\n", (lpFile1 == nullptr ? lrFileName1 : lrFileName2).c_str());
+		if (lpFile1 != nullptr)
+			fclose(lpFile1);
+		if (lpFile2 != nullptr)
+			fclose(lpFile2);
+		return 2;
+	}
+	
+	int lResult = 0;
+	unsigned lNumSteps = 0;
+	for (;;)
+	{
+		unsigned lStep1, lStep2;
+		uint64_t lHash1, lHash2;
+		bool lHave1 = fscanf(lpFile1, "%u %" SCNx64, &lStep1, &lHash1) == 2;
+		bool lHave2 = fscanf(lpFile2, "%u %" SCNx64, &lStep2, &lHash2) == 2;
+		if (!lHave1 && !lHave2)
+		{
+			printf("The logs match for all %u steps\n", lNumSteps);
+			break;
+		}
+		if (lHave1 != lHave2)
+		{
+			printf("The logs match for %u steps, after which \"%s\" ends\n", lNumSteps,
+				   (lHave1 ? lrFileName2 : lrFileName1).c_str());
+			lResult = 1;
+			break;
+		}
+		if (lStep1 != lStep2 || lHash1 != lHash2)
+		{
+			printf("First difference at step %u: %016" PRIx64 " in \"%s\", but step %u: %016" PRIx64 " in \"%s\"\n",
+				   lStep1, lHash1, lrFileName1.c_str(), lStep2, lHash2, lrFileName2.c_str());
+			lResult = 1;
+			break;
+		}
+		++lNumSteps;
+	}
+	
+	fclose(lpFile1);
+	fclose(lpFile2);
+	return lResult;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,62 @@
+//------------------------------------------------------------------------------
+// statehash: A quick hash of the simulation state, to check that two runs (or
+//            two builds) play out identically, and logs of it for comparing.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+// FNV-1a over 32-bit words.  Floats are hashed by their bits, so any difference at all shows up.
+class StateHash
+{
+public:
+	StateHash() : mHash(14695981039346656037ULL) {}
+	
+	void add(uint32_t lVal)	{ mHash = (mHash ^ lVal) * 1099511628211ULL; }
+	void add(int32_t lVal)	{ add(uint32_t(lVal)); }
+	void add(bool lVal)		{ add(uint32_t(lVal ? 1 : 0)); }
+	void add(float lVal)
+	{
+		uint32_t lBits;
+		memcpy(&lBits, &lVal, sizeof(lBits));
+		add(lBits);
+	}
+	
+	uint64_t value() const { return mHash; }
+	
+private:
+	uint64_t mHash;
+};
+
+//------------------------------------------------------------------------------
+
+// A text file with a line per step: the step number and the hash in hex
+class HashLog
+{
+public:
+	HashLog();
+	~HashLog();
+	
+	bool open(const std::string& lrFileName);
+	void add(uint32_t lStep, uint64_t lHash);
+	
+	// Prints the first step where the two logs differ.  Returns 0 if they match, 1 if they don't, or 2 if either
+	// can't be read.
+	static int compare(const std::string& lrFileName1, const std::string& lrFileName2);
+	
+private:
+	FILE* mpFile;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // STATEHASH_H
@@ -6,6 +6,8 @@
 
 #include "texturemanager.h"
 
+#include "jobsystem.h"
+#include "platform.h"
 #include "useful.h"
 
 #include <SDL/SDL_image.h>
@@ -19,7 +21,8 @@ TextureManager gTextureManager;
 
 //------------------------------------------------------------------------------
 
-TextureManager::TextureManager()
+TextureManager::TextureManager() :
+	mUseGL(true)
 {
 }
 
@@ -32,8 +35,9 @@ TextureManager::~TextureManager()
 
 //------------------------------------------------------------------------------
 
-void TextureManager::init()
+void TextureManager::init(GLUsage lUsage)
 {
+	mUseGL = (lUsage == UseGL);
 }
 
 //------------------------------------------------------------------------------
@@ -43,34 +47,84 @@ void TextureManager::shutDown()
 	for (auto liTexture: mTextures)
 		delete liTexture.second;
 	mTextures.clear();
+	
+	// Anything decoded but never used
+	for (auto liSurface: mDecodedSurfaces)
+		SDL_FreeSurface(liSurface.second);
+	mDecodedSurfaces.clear();
 }
 
 //------------------------------------------------------------------------------
 
 Texture* TextureManager::load(const std::string &lrFileName)
 {
+	std::lock_guard<std::mutex> lLock(mTexturesMutex);
+	
 	// Return an existing surface if available
 	auto liTexture = mTextures.find(lrFileName);
 	if (liTexture != mTextures.end())
 		return liTexture->second;
 	
-	printf("Loading texture \"%s\"\n", lrFileName.c_str());
-	SDL_Surface* lpSurface = IMG_Load(lrFileName.c_str());
+	// Use the decoded image if there is one
+	SDL_Surface* lpSurface = nullptr;
+	auto liDecoded = mDecodedSurfaces.find(lrFileName);
+	if (liDecoded != mDecodedSurfaces.end())
+	{
+		lpSurface = liDecoded->second;
+		mDecodedSurfaces.erase(liDecoded);
+	}
+	else
+	{
+		printf("Loading texture \"%s\"\n", lrFileName.c_str());
+		lpSurface = IMG_Load(lrFileName.c_str());
+	}
 	ASSERT2(lpSurface != nullptr, "Texture load failed.");
-	Texture* lpTexture = new Texture(lpSurface);
+	Texture* lpTexture = new Texture(lpSurface, Texture::kLinear, mUseGL);
 	mTextures[lrFileName] = lpTexture;
 	return lpTexture;
 }
 
+//------------------------------------------------------------------------------
+
+void TextureManager::initDecoding()
+{
+	// The decoders are otherwise set up lazily by the first load, which isn't safe with several threads loading
+	IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+}
+
+//------------------------------------------------------------------------------
+
+void TextureManager::decode(const std::vector<std::string>& lrFileNames)
+{
+	// One image per job, as they vary so much in size
+	gJobSystem.parallelFor(0, lrFileNames.size(), 1, [this, &lrFileNames](size_t lIndex, size_t)
+	{
+		const std::string& lrFileName = lrFileNames[lIndex];
+		printf("Decoding texture \"%s\"\n", lrFileName.c_str());
+		SDL_Surface* lpSurface = IMG_Load(lrFileName.c_str());
+		if (lpSurface == nullptr)
+		{
+			printf("Error decoding texture \"%s\"\n", lrFileName.c_str());
+			return;
+		}
+		
+		std::lock_guard<std::mutex> lLock(mDecodedSurfacesMutex);
+		SDL_Surface*& lrDecoded = mDecodedSurfaces[lrFileName];
+		if (lrDecoded != nullptr)
+			SDL_FreeSurface(lrDecoded);
+		lrDecoded = lpSurface;
+	});
+}
+
 //------------------------------------------------------------------------------
 // Texture
 //------------------------------------------------------------------------------
 
-Texture::Texture(SDL_Surface* lpSurface, FilteringType lFilteringType) :
-	mpSurface(lpSurface),
+Texture::Texture(SDL_Surface* lpSurface, FilteringType lFilteringType, bool lUploadToGL) :
+	mpSurface(lUploadToGL ? Platform::convertSurfaceForGL(lpSurface) : lpSurface),
 	mTexID(0)
 {
-	if (mpSurface != nullptr)
+	if (mpSurface != nullptr && lUploadToGL)
 	{
 		GLint lFilterVal = (lFilteringType == kLinear) ? GL_LINEAR : GL_NEAREST;
 		
@@ -91,7 +145,8 @@ Texture::~Texture()
 {
 	if (mpSurface != nullptr)
 	{
-		glDeleteTextures(1, &mTexID);
+		if (mTexID != 0)
+			glDeleteTextures(1, &mTexID);
 		SDL_FreeSurface(mpSurface);
 		mpSurface = nullptr;
 	}
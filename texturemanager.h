@@ -8,8 +8,10 @@
 #define TEXTUREMANAGER_H
 
 #include <GLES2/gl2.h>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 //------------------------------------------------------------------------------
 
@@ -24,13 +26,27 @@ public:
 	TextureManager();
 	~TextureManager();
 	
-	void init();
+	// Without GL, textures are still loaded so that their sizes are available to the simulation, but nothing is
+	// uploaded and they can't be rendered
+	enum GLUsage { UseGL, DoNotUseGL };
+	void init(GLUsage lUsage = UseGL);
 	void shutDown();
 	
+	// Safe to call from several worlds' threads at once, as long as GL isn't used
 	Texture* load(const std::string& lrFileName);
 	
+	// Decodes images ahead of time, so that load() only has to upload them.  The images are spread over the job
+	// system's threads.  This can be called from any thread, and from several at once, but must finish before the
+	// images are loaded.  initDecoding() must be called first.
+	static void initDecoding();
+	void decode(const std::vector<std::string>& lrFileNames);
+	
 private:
 	std::unordered_map<std::string, Texture*> mTextures;
+	std::mutex mTexturesMutex;
+	std::unordered_map<std::string, SDL_Surface*> mDecodedSurfaces;
+	std::mutex mDecodedSurfacesMutex;
+	bool mUseGL;
 };
 
 extern TextureManager gTextureManager;
@@ -42,7 +58,8 @@ class Texture
 public:
 	enum FilteringType { kNearest, kLinear };
 	
-	Texture(SDL_Surface* lpSurface, FilteringType lFilteringType = kLinear);	// the texture takes ownership of this surface
+	// The texture takes ownership of this surface
+	Texture(SDL_Surface* lpSurface, FilteringType lFilteringType = kLinear, bool lUploadToGL = true);
 	~Texture();
 	
 	void activate(GLenum lTextureStage = GL_TEXTURE0);
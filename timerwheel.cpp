@@ -0,0 +1,272 @@
+//------------------------------------------------------------------------------
+// TimerWheel: Timers counted in whole ticks, kept in a hierarchy of wheels so
+//             that adding, cancelling and moving on a tick all cost the same
+//             however many timers are pending.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "timerwheel.h"
+
+#include "snapshot.h"
+#include "useful.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+
+TimerWheel::TimerWheel() :
+	mNow(0),
+	mNextSequence(0),
+	mFirstFree(kNone)
+{
+	std::fill(mSlotHeads, mSlotHeads + kNumLevels * kNumSlots, kNone);
+	std::fill(mSlotTails, mSlotTails + kNumLevels * kNumSlots, kNone);
+}
+
+//------------------------------------------------------------------------------
+
+TimerHandle TimerWheel::add(uint32_t lDelayTicks, uint32_t lPayload)
+{
+	ASSERT2(lDelayTicks <= kMaxDelayTicks, "timer delay too long");
+	
+	int32_t lIndex = mFirstFree;
+	if (lIndex == kNone)
+	{
+		ASSERT2(mTimers.size() <= TimerHandle::kMaxIndex, "too many timers");
+		lIndex = int32_t(mTimers.size());
+		mTimers.push_back(Timer());
+		mTimers.back().mGeneration = 0;
+	}
+	else
+		mFirstFree = mTimers[lIndex].mNext;
+	
+	Timer& lrTimer = mTimers[lIndex];
+	lrTimer.mDueTick = mNow + max(lDelayTicks, 1u);
+	lrTimer.mSequence = mNextSequence++;
+	lrTimer.mPayload = lPayload;
+	lrTimer.mGeneration = lrTimer.mGeneration < TimerHandle::kMaxGeneration ? lrTimer.mGeneration + 1 : 1;
+	link(lIndex);
+	return TimerHandle(uint32_t(lIndex), lrTimer.mGeneration);
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::cancel(TimerHandle lTimer)
+{
+	if (findPending(lTimer) == nullptr)
+		return;
+	
+	int32_t lIndex = int32_t(lTimer.index());
+	unlink(lIndex);
+	mTimers[lIndex].mNext = mFirstFree;
+	mFirstFree = lIndex;
+}
+
+//------------------------------------------------------------------------------
+
+bool TimerWheel::isPending(TimerHandle lTimer) const
+{
+	return findPending(lTimer) != nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t TimerWheel::ticksLeft(TimerHandle lTimer) const
+{
+	const Timer* lpTimer = findPending(lTimer);
+	return lpTimer != nullptr ? lpTimer->mDueTick - mNow : 0;
+}
+
+//------------------------------------------------------------------------------
+
+TimerWheel::Timer* TimerWheel::findPending(TimerHandle lTimer)
+{
+	return const_cast<Timer*>(static_cast<const TimerWheel*>(this)->findPending(lTimer));
+}
+
+//------------------------------------------------------------------------------
+
+const TimerWheel::Timer* TimerWheel::findPending(TimerHandle lTimer) const
+{
+	if (lTimer.isNull() || lTimer.index() >= mTimers.size())
+		return nullptr;
+	const Timer& lrTimer = mTimers[lTimer.index()];
+	return lrTimer.mSlot != kNone && lrTimer.mGeneration == lTimer.generation() ? &lrTimer : nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::advance(std::vector<Fired>* lpFiredOut)
+{
+	lpFiredOut->clear();
+	++mNow;
+	
+	// Anything due in the block of ticks that's just started drops down from the levels above, top first, so that a
+	// timer can fall more than one level at once
+	for (int lLevel = kNumLevels - 1; lLevel > 0; --lLevel)
+		if ((mNow & ((1u << (kSlotBits * lLevel)) - 1)) == 0)
+			cascade(lLevel);
+	
+	int32_t lSlot = int32_t(mNow & kSlotMask);
+	int32_t lFirstFired = mSlotHeads[lSlot];
+	mSlotHeads[lSlot] = kNone;
+	mSlotTails[lSlot] = kNone;
+	
+	size_t lFirstOut = lpFiredOut->size();
+	for (int32_t lIndex = lFirstFired; lIndex != kNone; )
+	{
+		Timer& lrTimer = mTimers[lIndex];
+		ASSERT(lrTimer.mDueTick == mNow);
+		int32_t lNextIndex = lrTimer.mNext;
+		
+		Fired lFired;
+		lFired.mTimer = TimerHandle(uint32_t(lIndex), lrTimer.mGeneration);
+		lFired.mPayload = lrTimer.mPayload;
+		lpFiredOut->push_back(lFired);
+		
+		lrTimer.mSlot = kNone;
+		lrTimer.mNext = mFirstFree;
+		mFirstFree = lIndex;
+		lIndex = lNextIndex;
+	}
+	
+	// Slots are kept in the order added anyway, but this makes sure of it (there's rarely more than one)
+	std::stable_sort(lpFiredOut->begin() + lFirstOut, lpFiredOut->end(), [this](const Fired& lrA, const Fired& lrB)
+	{
+		return mTimers[lrA.mTimer.index()].mSequence < mTimers[lrB.mTimer.index()].mSequence;
+	});
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::link(int32_t lIndex)
+{
+	Timer& lrTimer = mTimers[lIndex];
+	ASSERT(lrTimer.mDueTick - mNow <= kMaxDelayTicks);		// due now is fine, when cascading
+	
+	// The lowest level where the due tick and now are in the same block of the level above
+	uint32_t lDiffBits = lrTimer.mDueTick ^ mNow;
+	int lLevel = 0;
+	while (lLevel < kNumLevels - 1 && (lDiffBits >> (kSlotBits * (lLevel + 1))) != 0)
+		++lLevel;
+	
+	int32_t lSlot = lLevel * int32_t(kNumSlots) + int32_t((lrTimer.mDueTick >> (kSlotBits * lLevel)) & kSlotMask);
+	lrTimer.mSlot = lSlot;
+	lrTimer.mPrev = mSlotTails[lSlot];
+	lrTimer.mNext = kNone;
+	if (mSlotTails[lSlot] != kNone)
+		mTimers[mSlotTails[lSlot]].mNext = lIndex;
+	else
+		mSlotHeads[lSlot] = lIndex;
+	mSlotTails[lSlot] = lIndex;
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::unlink(int32_t lIndex)
+{
+	Timer& lrTimer = mTimers[lIndex];
+	if (lrTimer.mPrev != kNone)
+		mTimers[lrTimer.mPrev].mNext = lrTimer.mNext;
+	else
+		mSlotHeads[lrTimer.mSlot] = lrTimer.mNext;
+	if (lrTimer.mNext != kNone)
+		mTimers[lrTimer.mNext].mPrev = lrTimer.mPrev;
+	else
+		mSlotTails[lrTimer.mSlot] = lrTimer.mPrev;
+	lrTimer.mSlot = kNone;
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::cascade(int lLevel)
+{
+	int32_t lSlot = lLevel * int32_t(kNumSlots) + int32_t((mNow >> (kSlotBits * lLevel)) & kSlotMask);
+	int32_t lIndex = mSlotHeads[lSlot];
+	mSlotHeads[lSlot] = kNone;
+	mSlotTails[lSlot] = kNone;
+	while (lIndex != kNone)
+	{
+		int32_t lNextIndex = mTimers[lIndex].mNext;
+		link(lIndex);
+		lIndex = lNextIndex;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::rebuildFreeList()
+{
+	// Lowest index first, as a fresh wheel would give them out
+	mFirstFree = kNone;
+	for (int32_t lIndex = int32_t(mTimers.size()) - 1; lIndex >= 0; --lIndex)
+		if (mTimers[lIndex].mSlot == kNone)
+		{
+			mTimers[lIndex].mNext = mFirstFree;
+			mFirstFree = lIndex;
+		}
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::saveState(SnapshotWriter& lrWriter) const
+{
+	lrWriter.write(mNow);
+	lrWriter.write(mNextSequence);
+	lrWriter.write(uint32_t(mTimers.size()));
+	for (const Timer& lrTimer: mTimers)
+	{
+		lrWriter.write(lrTimer.mGeneration);
+		lrWriter.write(uint8_t(lrTimer.mSlot != kNone ? 1 : 0));
+		if (lrTimer.mSlot == kNone)
+			continue;
+		lrWriter.write(lrTimer.mDueTick);
+		lrWriter.write(lrTimer.mSequence);
+		lrWriter.write(lrTimer.mPayload);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void TimerWheel::loadState(SnapshotReader& lrReader)
+{
+	std::fill(mSlotHeads, mSlotHeads + kNumLevels * kNumSlots, kNone);
+	std::fill(mSlotTails, mSlotTails + kNumLevels * kNumSlots, kNone);
+	
+	uint32_t lNumTimers = 0;
+	lrReader.read(&mNow);
+	lrReader.read(&mNextSequence);
+	lrReader.read(&lNumTimers);
+	if (lrReader.failed() || lNumTimers > TimerHandle::kMaxIndex + 1)
+		lNumTimers = 0;
+	
+	std::vector<int32_t> lPending;
+	mTimers.resize(lNumTimers);
+	for (uint32_t lIndex = 0; lIndex < lNumTimers; ++lIndex)
+	{
+		Timer& lrTimer = mTimers[lIndex];
+		uint8_t lIsPending = 0;
+		lrReader.read(&lrTimer.mGeneration);
+		lrReader.read(&lIsPending);
+		lrTimer.mSlot = kNone;
+		if (lIsPending == 0)
+			continue;
+		lrReader.read(&lrTimer.mDueTick);
+		lrReader.read(&lrTimer.mSequence);
+		lrReader.read(&lrTimer.mPayload);
+		if (lrTimer.mDueTick != mNow)
+			lPending.push_back(int32_t(lIndex));
+	}
+	
+	// Put back in the order added, as they would have been
+	std::sort(lPending.begin(), lPending.end(), [this](int32_t lA, int32_t lB)
+	{
+		return mTimers[lA].mSequence < mTimers[lB].mSequence;
+	});
+	for (int32_t lIndex: lPending)
+		link(lIndex);
+	rebuildFreeList();
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,116 @@
+//------------------------------------------------------------------------------
+// TimerWheel: Timers counted in whole ticks, kept in a hierarchy of wheels so
+//             that adding, cancelling and moving on a tick all cost the same
+//             however many timers are pending.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class SnapshotReader;
+class SnapshotWriter;
+
+//------------------------------------------------------------------------------
+
+class TimerHandle
+{
+public:
+	static const int kIndexBits = 20;
+	static const uint32_t kMaxIndex = (1u << kIndexBits) - 1;
+	static const uint32_t kMaxGeneration = (1u << (32 - kIndexBits)) - 1;
+	
+	TimerHandle() : mValue(0) {}
+	TimerHandle(uint32_t lIndex, uint32_t lGeneration) : mValue((lGeneration << kIndexBits) | lIndex) {}
+	
+	uint32_t index() const		{ return mValue & kMaxIndex; }
+	uint32_t generation() const	{ return mValue >> kIndexBits; }
+	bool isNull() const			{ return mValue == 0; }
+	
+	// The packed form, for snapshots
+	uint32_t value() const { return mValue; }
+	static TimerHandle fromValue(uint32_t lValue) { TimerHandle lHandle; lHandle.mValue = lValue; return lHandle; }
+	
+	bool operator==(TimerHandle lOther) const { return mValue == lOther.mValue; }
+	bool operator!=(TimerHandle lOther) const { return mValue != lOther.mValue; }
+	
+private:
+	uint32_t mValue;
+};
+
+//------------------------------------------------------------------------------
+
+// Level 0 has a slot for each of the next 64 ticks; each level above has a slot for 64 times as many.  A timer goes
+// in the lowest level that can tell its tick apart from now, and drops down a level each time that level's current
+// slot comes round, until it reaches level 0 and fires.  So each timer moves at most kNumLevels times in its life.
+class TimerWheel
+{
+public:
+	static const int kSlotBits = 6;
+	static const int kNumLevels = 4;
+	static const uint32_t kMaxDelayTicks = (1u << (kSlotBits * kNumLevels)) - 1;		// about three days at 60Hz
+	
+	struct Fired
+	{
+		TimerHandle mTimer;
+		uint32_t mPayload;
+	};
+	
+	TimerWheel();
+	
+	uint32_t now() const { return mNow; }
+	
+	// The payload is handed back when the timer fires, lDelayTicks (at least 1) after now.  Handles to timers that
+	// have fired or been cancelled go stale, so they're safe to keep.
+	TimerHandle add(uint32_t lDelayTicks, uint32_t lPayload);
+	void cancel(TimerHandle lTimer);
+	bool isPending(TimerHandle lTimer) const;
+	uint32_t ticksLeft(TimerHandle lTimer) const;		// 0 if it's not pending
+	
+	// Moves on a tick.  The timers that fire are given in the order they were added, however they got to level 0.
+	void advance(std::vector<Fired>* lpFiredOut);
+	
+	// The wheel is rebuilt from the timers on loading, so handles stay valid and timers fire in the same order
+	void saveState(SnapshotWriter& lrWriter) const;
+	void loadState(SnapshotReader& lrReader);
+	
+private:
+	static const uint32_t kNumSlots = 1u << kSlotBits;
+	static const uint32_t kSlotMask = kNumSlots - 1;
+	static const int32_t kNone = -1;
+	
+	struct Timer
+	{
+		uint32_t mDueTick;
+		uint32_t mSequence;		// when it was added, to put timers that fire together in order
+		uint32_t mPayload;
+		uint32_t mGeneration;
+		int32_t mPrev;			//
+		int32_t mNext;			// in its slot's list, or mNext in the free list
+		int32_t mSlot;			// kNone when it's free
+	};
+	
+	Timer* findPending(TimerHandle lTimer);
+	const Timer* findPending(TimerHandle lTimer) const;
+	void link(int32_t lIndex);
+	void unlink(int32_t lIndex);
+	void cascade(int lLevel);
+	void rebuildFreeList();
+	
+	uint32_t mNow;
+	uint32_t mNextSequence;
+	std::vector<Timer> mTimers;
+	int32_t mFirstFree;
+	int32_t mSlotHeads[kNumLevels * kNumSlots];
+	int32_t mSlotTails[kNumLevels * kNumSlots];		// timers are appended, so each slot stays in the order added
+};
+
+//------------------------------------------------------------------------------
+
+#endif // TIMERWHEEL_H
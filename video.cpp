@@ -6,11 +6,10 @@
 
 #include "video.h"
 
+#include "platform.h"
 #include "settings.h"
 #include "useful.h"
 #include <GLES2/gl2.h>
-#include <SDL/SDL_compat.h>
-#include <SDL/SDL_surface.h>
 
 #define GLM_FORCE_RADIANS
 #include "glm/glm.hpp"
@@ -44,12 +43,9 @@ bool Video::init(int lDisplayWidth, int lDisplayHeight)
 {
 	ASSERT(!mInitialised);
 	
-	mpDisplaySurface = SDL_SetVideoMode(lDisplayWidth, lDisplayHeight, 32, SDL_HWSURFACE | SDL_GL_DOUBLEBUFFER | SDL_OPENGL);
-	if (mpDisplaySurface == nullptr)
-	{
-		printf("Failed to set SDL video mode %dx%dx32\n", lDisplayWidth, lDisplayHeight);
+	if (!Platform::openWindow(lDisplayWidth, lDisplayHeight))
 		return false;
-	}
+	mpDisplaySurface = Platform::getDisplaySurface();
 	
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	glViewport(0, 0, lDisplayWidth, lDisplayHeight);
@@ -71,11 +67,8 @@ void Video::shutDown()
 		glDeleteProgram(lProgID);
 	mShaderProgSet.clear();
 	
-	if (mpDisplaySurface != nullptr)
-	{
-		SDL_FreeSurface(mpDisplaySurface);
-		mpDisplaySurface = nullptr;
-	}
+	mpDisplaySurface = nullptr;		// owned by the platform
+	Platform::closeWindow();
 	
 	mInitialised = false;
 }
@@ -110,7 +103,7 @@ void Video::clear()
 
 void Video::flip()
 {
-	SDL_GL_SwapBuffers();
+	Platform::swapBuffers();
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,444 @@
+//------------------------------------------------------------------------------
+// World: One self-contained game - its entities, camera, player, timers,
+//        random numbers and input.  Several worlds can run side by side in one
+//        process, sharing only the read-only assets (settings, textures).
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "world.h"
+
+#include "audiomanager.h"
+#include "camera.h"
+#include "houseentity.h"
+#include "jobsystem.h"
+#include "manentity.h"
+#include "playercarentity.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "spriteentity.h"
+#include "statehash.h"
+#include "texturemanager.h"
+#include "useful.h"
+
+#include <cmath>
+#include <sstream>
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	std::vector<Name> houseNames(const std::vector<std::string>& lrLabels)
+	{
+		std::vector<Name> lNames;
+		for (const std::string& lrLabel: lrLabels)
+			lNames.push_back(Name("house_" + lrLabel));
+		return lNames;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+World::World(float lViewWidth, float lViewHeight) :
+	mEntities(this),
+	mpCamera(nullptr),
+	mSoundEnabled(false),
+	mNumSteps(0),
+	mOldestSnapshotStep(kNoSnapshotsKept),
+	mScheduler(1.0f / Settings::getFloat("simulation/step_rate")),
+	mFareScript(this),
+	mMessageScript(this),
+	mViewWidth(lViewWidth),
+	mViewHeight(lViewHeight),
+	mAreaLeft(0.0f),
+	mAreaRight(0.0f),
+	mAreaTop(0.0f),
+	mAreaBottom(0.0f),
+	mCash(0)
+{
+	mHandling.loadFromSettings();
+	mScheduler.add(&mFareScript);
+	mScheduler.add(&mMessageScript);
+}
+
+//------------------------------------------------------------------------------
+
+World::~World()
+{
+	mEntities.shutDown();
+	mInput.shutDown();
+	delete mpCamera;
+	mpCamera = nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+void World::init()
+{
+	mEntities.init();
+	
+	mpCamera = new Camera(this, mViewWidth * 0.5f, mViewHeight * 0.5f, mViewWidth, mViewHeight);
+	
+	initBackground();
+	initObjects();
+	
+	//CarEntity* lpCar = mEntities.newEntity<CarEntity>(50.0f, 50.0f, "red");
+	//mEntities.registerEntity(lpCar);
+	PlayerCarEntity* lpPlayer = mEntities.newEntity<PlayerCarEntity>(300.0f, 300.0f);
+	mEntities.registerEntity(lpPlayer);
+	mPlayer = lpPlayer->handle();
+}
+
+//------------------------------------------------------------------------------
+
+void World::initBackground()
+{
+	Texture* lpTexture = gTextureManager.load("data/grass.jpg");
+	
+	float lCentreX = mViewWidth * 0.5f;
+	float lCentreY = mViewHeight * 0.5f;
+	
+	for (int lXTile = -1; lXTile <= 1; ++lXTile)
+		for (int lYTile = -1; lYTile <= 1; ++lYTile)
+		{
+			float lX = lCentreX + lXTile * mViewWidth;
+			float lY = lCentreY + lYTile * mViewHeight;
+			SpriteEntity* lpBackground = mEntities.newEntity<SpriteEntity>(lX, lY);
+			lpBackground->setName((std::ostringstream() << "background (" << lXTile << ", " << lYTile << ")").str());
+			lpBackground->setTexture(lpTexture);
+			lpBackground->setBlendEnabled(false);
+			lpBackground->setActivity(Entity::kStatic);
+			mEntities.registerEntity(lpBackground);	// must be first
+		}
+	
+	mAreaLeft = -mViewWidth;
+	mAreaTop = -mViewHeight;
+	mAreaRight = 2.0f * mViewWidth;
+	mAreaBottom = 2.0f * mViewHeight;
+}
+
+//------------------------------------------------------------------------------
+
+void World::initObjects()
+{
+	// Absolute names, as other start-up tasks may be reading settings at the same time
+	std::vector<std::string> lHouseNames = Settings::getStringVector("level/houses");
+	for (const std::string& lrName: lHouseNames)
+	{
+		std::string lPosKey = "level/house" + lrName + "_pos";
+		std::vector<float> lHousePos = Settings::getFloatVector(lPosKey);
+		float lHouseX = getFloatParam(lHousePos, 0) - 800;	//
+		float lHouseY = getFloatParam(lHousePos, 1) - 600;	// for typing convenience :)
+		HouseEntity* lpNewHouse = mEntities.newEntity<HouseEntity>(lHouseX, lHouseY);
+		
+		std::string lTexKey = "level/house" + lrName + "_tex";
+		std::string lTex = Settings::getString(lTexKey);
+		if (lTex.empty())
+			lTex = (std::ostringstream() << (1 + mRandom.getInt(RandomManager::kLevelStream, 9))).str();
+		lpNewHouse->setTexture(gTextureManager.load("data/tex/house-" + lTex + ".jpg"));
+		lpNewHouse->setName("house_" + lrName);
+		
+		mEntities.registerEntity(lpNewHouse);
+	}
+	
+	// The men are spawned together from packed parameters: x, y and texture index
+	std::vector<std::string> lMenNames = Settings::getStringVector("level/men");
+	std::vector<float> lMenParams;
+	lMenParams.reserve(lMenNames.size() * 3);
+	for (const std::string& lrName: lMenNames)
+	{
+		std::string lPosKey = "level/man" + lrName + "_pos";
+		std::vector<float> lHousePos = Settings::getFloatVector(lPosKey);
+		lMenParams.push_back(getFloatParam(lHousePos, 0) - 800);	//
+		lMenParams.push_back(getFloatParam(lHousePos, 1) - 600);	// for typing convenience :)
+		lMenParams.push_back(float(1 + mRandom.getInt(RandomManager::kLevelStream, 5)));
+	}
+	mEntities.spawn(ManEntity::kTypeId, lMenParams.data(), 3, lMenNames.size());
+	
+	SpriteEntity* lpArrow = mEntities.newEntity<SpriteEntity>(0.0f, 0.0f);
+	lpArrow->setTexture(gTextureManager.load("data/tex/arrow.png"));
+	lpArrow->setVisible(false);
+	lpArrow->setBehindCamera(true);
+	lpArrow->setActivity(Entity::kStatic);		// placed by updateArrow()
+	mEntities.registerEntity(lpArrow);
+	mArrow = lpArrow->handle();
+}
+
+//------------------------------------------------------------------------------
+
+void World::step(float lTimeDeltaSec)
+{
+	++mNumSteps;
+	mInput.sampleStep();
+	PlayerCarEntity& lrPlayer = player();
+	mEntities.setLodFocus(lrPlayer.x(), lrPlayer.y());
+	mEntities.update(lTimeDeltaSec);
+	
+	mpCamera->savePreviousState();
+	mpCamera->updateFromPlayer(&player(), mAreaLeft, mAreaTop, mAreaRight, mAreaBottom);
+	
+	mScheduler.advance();
+	
+	mEntities.reclaimDead(mOldestSnapshotStep);
+}
+
+//------------------------------------------------------------------------------
+
+void World::stepInParallel(const std::vector<World*>& lrWorlds, int lNumSteps, float lStepSec, int lNumThreads)
+{
+	// Each job takes a contiguous block of worlds and runs all its steps, so there's no synchronisation at all until
+	// the end.  There are at most as many blocks as threads, so the job system's threads share them out.
+	size_t lNumWorlds = lrWorlds.size();
+	size_t lNumBlocks = size_t(clamp(lNumThreads, 1, max(int(lNumWorlds), 1)));
+	gJobSystem.parallelFor(0, lNumWorlds, (lNumWorlds + lNumBlocks - 1) / lNumBlocks,
+						   [&lrWorlds, lNumSteps, lStepSec](size_t lBegin, size_t lEnd)
+						   {
+							   for (size_t lIndex = lBegin; lIndex < lEnd; ++lIndex)
+								   for (int lStep = 0; lStep < lNumSteps; ++lStep)
+									   lrWorlds[lIndex]->step(lStepSec);
+						   });
+}
+
+//------------------------------------------------------------------------------
+
+void World::saveSnapshot(std::vector<uint8_t>* lpSnapshotOut) const
+{
+	lpSnapshotOut->clear();
+	SnapshotWriter lWriter(lpSnapshotOut);
+	
+	mEntities.saveState(lWriter);
+	mpCamera->saveState(lWriter);
+	mRandom.saveState(lWriter);
+	mInput.saveState(lWriter);
+	
+	lWriter.write(mNumSteps);
+	lWriter.write(int32_t(mCash));
+	lWriter.write(mCurrentHouse.value());
+	lWriter.write(mCurrentTarget.value());
+	lWriter.writeString(mStatusMsg);
+	lWriter.writeString(mStatusMsg2);
+	mScheduler.saveState(lWriter);
+}
+
+//------------------------------------------------------------------------------
+
+bool World::loadSnapshot(const std::vector<uint8_t>& lrSnapshot)
+{
+	SnapshotReader lReader(lrSnapshot);
+	
+	if (!mEntities.loadState(lReader))
+		return false;
+	mpCamera->loadState(lReader);
+	mRandom.loadState(lReader);
+	mInput.loadState(lReader);
+	
+	int32_t lCash;
+	uint32_t lCurrentHouse, lCurrentTarget;
+	lReader.read(&mNumSteps);
+	lReader.read(&lCash);
+	lReader.read(&lCurrentHouse);
+	lReader.read(&lCurrentTarget);
+	lReader.readString(&mStatusMsg);
+	lReader.readString(&mStatusMsg2);
+	mScheduler.loadState(lReader);
+	
+	mCash = lCash;
+	mCurrentHouse = EntityHandle::fromValue(lCurrentHouse);
+	mCurrentTarget = EntityHandle::fromValue(lCurrentTarget);
+	return !lReader.failed() && lReader.atEnd();
+}
+
+//------------------------------------------------------------------------------
+
+uint64_t World::stateHash() const
+{
+	StateHash lHash;
+	for (const Entity* lpEntity: mEntities.allEntities())
+	{
+		if (lpEntity->handle() == mArrow)
+			continue;		// only moved by updateArrow(), so it differs between headless and windowed runs
+		lHash.add(int32_t(lpEntity->id()));
+		lpEntity->addToHash(lHash);
+	}
+	lHash.add(int32_t(mCash));
+	lHash.add(int32_t(mFareScript.ticksLeft()));
+	return lHash.value();
+}
+
+//------------------------------------------------------------------------------
+
+void World::updateArrow()
+{
+	const TargetEntity* lpTarget = currentTarget();
+	SpriteEntity* lpArrow = mEntities.entity<SpriteEntity>(mArrow);
+	bool lShowArrow = lpTarget != nullptr && !mpCamera->canSee(lpTarget);
+	lpArrow->setVisible(lShowArrow);
+	if (!lShowArrow)
+		return;
+	
+	float lOffsetX = lpTarget->x() - mpCamera->x();
+	float lOffsetY = lpTarget->y() - mpCamera->y();
+	// Push the largest offset to the edge, and then the other one will be an appropriate fraction of it
+	float lFactor = 1.0f / max(fabsf(lOffsetX), fabsf(lOffsetY));
+	float lOffsetXFactor = lOffsetX * lFactor;
+	float lOffsetYFactor = lOffsetY * lFactor;
+	
+	float lRotationRad, lUnused;
+	getPolarFromRect(lOffsetX, lOffsetY, &lUnused, &lRotationRad);
+	
+	float lHalfViewWidth = mViewWidth * 0.5f;
+	float lHalfViewHeight = mViewHeight * 0.5f;
+	float lOffsetWidth = lHalfViewWidth - lpArrow->halfWidth();
+	float lOffsetHeight = lHalfViewHeight - lpArrow->halfHeight();
+	lpArrow->setPos(lHalfViewWidth  + lOffsetXFactor * lOffsetWidth,
+					lHalfViewHeight + lOffsetYFactor * lOffsetHeight);
+	lpArrow->setRotationRad(lRotationRad);
+	lpArrow->savePreviousState();		// it's placed every frame, so there's nothing to interpolate
+}
+
+//------------------------------------------------------------------------------
+
+void World::setStatusMessage(const std::string &lrText, const std::string& lrText2)
+{
+	static const float kDisplayTimeSec = Settings::getFloat("general/msg_display_time_sec");
+	mStatusMsg  = lrText2.empty() ? std::string() : lrText;
+	mStatusMsg2 = lrText2.empty() ? lrText : lrText2;
+	mMessageScript.show(lrText2.empty() ? kDisplayTimeSec : kDisplayTimeSec * 1.5f);
+}
+
+//------------------------------------------------------------------------------
+
+HouseEntity* World::findHouse(const std::string &lrLabel) const
+{
+	return findHouse(Name("house_" + lrLabel));
+}
+
+//------------------------------------------------------------------------------
+
+HouseEntity* World::findHouse(Name lHouseName) const
+{
+	static const Name kHouseTag("house");
+	Entity* lpEntity = mEntities.findByName(lHouseName);
+	return lpEntity != nullptr && lpEntity->hasTag(kHouseTag) ? static_cast<HouseEntity*>(lpEntity) : nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+HouseEntity* World::pickRandomHouse()
+{
+	static const std::vector<Name> kDestinations = houseNames(Settings::getStringVector("level/destinations"));
+	
+	HouseEntity* lpHouse = nullptr;
+	do
+	{
+		int lTargetIndex = mRandom.getInt(RandomManager::kPassengerStream, int(kDestinations.size()));
+		lpHouse = findHouse(kDestinations[lTargetIndex]);
+	} while (lpHouse != nullptr && lpHouse->handle() == mCurrentHouse);
+	
+	ASSERT(lpHouse != nullptr);
+	mCurrentHouse = lpHouse->handle();
+	return lpHouse;
+}
+
+//------------------------------------------------------------------------------
+
+void World::startFare(HouseEntity* lpHouse, float lStartX, float lStartY)
+{
+	float lTargetParams[] = { lpHouse->x(), lpHouse->y() + lpHouse->halfHeight(), lStartX, lStartY };
+	mEntities.commands().spawn(TargetEntity::kTypeId, lTargetParams, 4, &mCurrentTarget);
+	
+	setStatusMessage(lpHouse->getStartMessage(), lpHouse->getStartMessage2());
+	startCountdown();
+	playSound("collect", 3);
+}
+
+//------------------------------------------------------------------------------
+
+void World::losePassenger()
+{
+	HouseEntity* lpHouse = mEntities.entity<HouseEntity>(mCurrentHouse);
+	ASSERT(lpHouse != nullptr);
+	setStatusMessage(lpHouse->getLoseMessage());
+	TargetEntity* lpTarget = mEntities.entity<TargetEntity>(mCurrentTarget);
+	ASSERT(lpTarget != nullptr);
+	mEntities.kill(lpTarget);
+	mCurrentTarget = EntityHandle();
+	stopCountdown();
+	playSound("lose", 3);
+}
+
+//------------------------------------------------------------------------------
+
+void World::winPassenger(int lCashValue)
+{
+	HouseEntity* lpHouse = mEntities.entity<HouseEntity>(mCurrentHouse);
+	ASSERT(lpHouse != nullptr);
+	
+	std::string lMsg = lpHouse->getWinMessage();
+	char lBuf[256];
+	snprintf(lBuf, sizeof(lBuf), lMsg.c_str(), lCashValue);
+	setStatusMessage(lBuf);
+	addCash(lCashValue);
+	stopCountdown();
+	mCurrentTarget = EntityHandle();	// it's being killed
+	playSound("win", 3);
+}
+
+//------------------------------------------------------------------------------
+
+void World::FareScript::run()
+{
+	static const float kFareTimeSec = 10.0f;
+	
+	SCRIPT_BEGIN();
+	SCRIPT_WAIT_SEC(kFareTimeSec);
+	mpWorld->losePassenger();
+	SCRIPT_END();
+}
+
+//------------------------------------------------------------------------------
+
+void World::MessageScript::run()
+{
+	SCRIPT_BEGIN();
+	SCRIPT_WAIT_SEC(mDisplaySec);
+	mpWorld->mStatusMsg.clear();
+	mpWorld->mStatusMsg2.clear();
+	SCRIPT_END();
+}
+
+//------------------------------------------------------------------------------
+
+PlayerCarEntity& World::player() const
+{
+	return *mEntities.entity<PlayerCarEntity>(mPlayer);
+}
+
+//------------------------------------------------------------------------------
+
+const TargetEntity* World::currentTarget() const
+{
+	return mEntities.entity<TargetEntity>(mCurrentTarget);
+}
+
+//------------------------------------------------------------------------------
+
+void World::playSound(const std::string &lrName, int lMaxNum)
+{
+	// Entities updating on other threads mustn't draw random numbers or touch the audio, so their sounds are played
+	// once the update has finished
+	if (mEntities.isUpdating())
+	{
+		mEntities.commands().playSound(Name(lrName), lMaxNum);
+		return;
+	}
+	
+	// The random number is drawn either way, so that a world plays out the same whether it's heard or not
+	int lIndex = 1 + mRandom.getInt(RandomManager::kSoundStream, lMaxNum);
+	if (!mSoundEnabled)
+		return;
+	std::string lFileName = (std::ostringstream() << "data/sfx/" << lrName << lIndex << ".ogg").str();
+	gAudioManager.loadSound(lFileName)->play();
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,161 @@
+//------------------------------------------------------------------------------
+// World: One self-contained game - its entities, camera, player, timers,
+//        random numbers and input.  Several worlds can run side by side in one
+//        process, sharing only the read-only assets (settings, textures).
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include "carhandling.h"
+#include "entitymanager.h"
+#include "inputmanager.h"
+#include "randommanager.h"
+#include "script.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class Camera;
+class HouseEntity;
+class PlayerCarEntity;
+class SpriteEntity;
+class TargetEntity;
+
+//------------------------------------------------------------------------------
+
+class World
+{
+public:
+	World(float lViewWidth, float lViewHeight);
+	~World();
+	
+	// Seed the random numbers (and set up any replay) before this
+	void init();
+	
+	void step(float lTimeDeltaSec);
+	
+	// Steps each world the given number of times, in up to lNumThreads blocks on the shared job system.  Worlds don't
+	// touch each other's state, so the results are the same whatever the number of threads.  The worlds shouldn't
+	// update their own entities in parallel as well, as a thread waiting for its entity chunks could pick up another
+	// world's block.
+	static void stepInParallel(const std::vector<World*>& lrWorlds, int lNumSteps, float lStepSec, int lNumThreads);
+	
+	// The whole simulation state, for rewinding, retrying, etc.  A snapshot can only be loaded into the world that
+	// saved it (or one set up the same way).  Loading returns false if the snapshot doesn't match.
+	void saveSnapshot(std::vector<uint8_t>* lpSnapshotOut) const;
+	bool loadSnapshot(const std::vector<uint8_t>& lrSnapshot);
+	
+	// A hash of the state that decides the outcome (entities, cash and countdown).  Two runs that are playing out the
+	// same way have the same hash after every step; it's cheap enough to check every step.
+	uint64_t stateHash() const;
+	uint32_t numSteps() const { return mNumSteps; }		// steps since init, rewound along with the snapshot
+	
+	// Dead entities are destroyed at the end of each step, once no snapshot that's kept could bring them back.  Tell
+	// the world the step of the oldest snapshot kept, if there are any.
+	static const uint32_t kNoSnapshotsKept = UINT32_MAX;
+	void setOldestSnapshotStep(uint32_t lStep) { mOldestSnapshotStep = lStep; }
+	
+	// Presentation: only the world being shown needs these
+	void updateArrow();
+	void setSoundEnabled(bool lEnabled) { mSoundEnabled = lEnabled; }
+	
+	EntityManager& entities()	{ return mEntities; }
+	Camera& camera() const		{ return *mpCamera; }
+	PlayerCarEntity& player() const;
+	RandomManager& random()		{ return mRandom; }
+	InputManager& input()		{ return mInput; }
+	CarHandling& handling()		{ return mHandling; }		// starts as the settings' values; can be tuned per world
+	const ScriptScheduler& scheduler() const { return mScheduler; }
+	
+	float areaLeft() const { return mAreaLeft; }
+	float areaRight() const { return mAreaRight; }
+	float areaTop() const { return mAreaTop; }
+	float areaBottom() const { return mAreaBottom; }
+	
+	int cash() const { return mCash; }
+	void addCash(int lAmount) { mCash += lAmount; }
+	
+	void setStatusMessage(const std::string& lrText, const std::string& lrText2 = std::string());
+	const std::string& statusMessage() const { return mStatusMsg; }
+	const std::string& statusMessage2() const { return mStatusMsg2; }
+	bool isShowingMessage() const { return mMessageScript.isRunning(); }
+	
+	HouseEntity* findHouse(const std::string& lrLabel) const;		// e.g. "a" for the house named "house_a"
+	HouseEntity* findHouse(Name lHouseName) const;					// quicker, with the full name interned already
+	HouseEntity* pickRandomHouse();
+	
+	bool havePassenger() const { return mFareScript.isRunning(); }
+	float countdownSec() const { return float(mFareScript.ticksLeft()) * mScheduler.tickSec(); }
+	void startCountdown() { mFareScript.start(); }
+	void stopCountdown() { mFareScript.stop(); }
+	void startFare(HouseEntity* lpHouse, float lStartX, float lStartY);	// the target's spawned after the update
+	void losePassenger();
+	void winPassenger(int lCashValue);
+	const TargetEntity* currentTarget() const;		// null without a passenger
+	
+	void playSound(const std::string& lrName, int lMaxNum);
+	
+private:
+	// The passenger's countdown: lose them if they're still in the car at the end
+	class FareScript : public Script
+	{
+	public:
+		FareScript(World* lpWorld) : mpWorld(lpWorld) {}
+	protected:
+		virtual void run();
+	private:
+		World* mpWorld;
+	};
+	
+	class MessageScript : public Script
+	{
+	public:
+		MessageScript(World* lpWorld) : mpWorld(lpWorld), mDisplaySec(0.0f) {}
+		void show(float lDisplaySec) { mDisplaySec = lDisplaySec; start(); }
+	protected:
+		virtual void run();
+	private:
+		World* mpWorld;
+		float mDisplaySec;		// only needed up to the first wait, so it isn't saved
+	};
+	
+	void initBackground();
+	void initObjects();
+	
+	EntityManager mEntities;
+	Camera* mpCamera;
+	EntityHandle mPlayer;
+	RandomManager mRandom;
+	InputManager mInput;
+	CarHandling mHandling;
+	bool mSoundEnabled;
+	uint32_t mNumSteps;
+	uint32_t mOldestSnapshotStep;
+	ScriptScheduler mScheduler;		// ticks once a step, after the entities have updated
+	FareScript mFareScript;
+	MessageScript mMessageScript;
+	
+	float mViewWidth, mViewHeight;
+	float mAreaLeft, mAreaRight;	//
+	float mAreaTop, mAreaBottom;	// accessible play area
+	
+	int mCash;
+	
+	// Handles rather than pointers, so that they can't dangle
+	EntityHandle mCurrentHouse;
+	EntityHandle mCurrentTarget;
+	EntityHandle mArrow;
+	
+	std::string mStatusMsg;
+	std::string mStatusMsg2;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // WORLD_H
@@ -0,0 +1,138 @@
+//------------------------------------------------------------------------------
+// WorldBatch: A set of worlds that are stepped together on the job system's
+//             threads, with controls in and observations out as flat float
+//             arrays.
+//             This is what envapi.h exposes.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#include "worldbatch.h"
+
+#include "envapi.h"
+#include "jobsystem.h"
+#include "manentity.h"
+#include "platform.h"
+#include "playercarentity.h"
+#include "settings.h"
+#include "useful.h"
+#include "world.h"
+
+//------------------------------------------------------------------------------
+
+WorldBatch::WorldBatch(int lNumWorlds, uint32_t lBaseSeed, int lNumThreads) :
+	mNumThreads(1),
+	mStepSec(1.0f / Settings::getFloat("simulation/step_rate")),
+	mViewWidth(Settings::getFloat("screen/width")),
+	mViewHeight(Settings::getFloat("screen/height")),
+	mTotalSteps(0.0),
+	mTotalStepMS(0.0)
+{
+	for (int lWorldIndex = 0; lWorldIndex < lNumWorlds; ++lWorldIndex)
+		mWorlds.push_back(createWorld(lBaseSeed + uint32_t(lWorldIndex)));
+	
+	if (lNumThreads <= 0 || lNumThreads > gJobSystem.numThreads())
+		lNumThreads = gJobSystem.numThreads();
+	mNumThreads = clamp(lNumThreads, 1, max(lNumWorlds, 1));
+}
+
+//------------------------------------------------------------------------------
+
+WorldBatch::~WorldBatch()
+{
+	for (World* lpWorld: mWorlds)
+		delete lpWorld;
+}
+
+//------------------------------------------------------------------------------
+
+World* WorldBatch::createWorld(uint32_t lSeed) const
+{
+	World* lpWorld = new World(mViewWidth, mViewHeight);
+	lpWorld->entities().setLoggingEnabled(false);
+	lpWorld->random().seed(lSeed);
+	lpWorld->init();
+	lpWorld->input().setControls(0.0f, 0.0f);		// never the keyboard
+	return lpWorld;
+}
+
+//------------------------------------------------------------------------------
+
+void WorldBatch::resetWorld(int lWorldIndex, uint32_t lSeed)
+{
+	ASSERT(lWorldIndex >= 0 && lWorldIndex < numWorlds());
+	delete mWorlds[lWorldIndex];
+	mWorlds[lWorldIndex] = createWorld(lSeed);
+}
+
+//------------------------------------------------------------------------------
+
+void WorldBatch::step(const float* lpControls, int lNumSteps, float* lpObsOut)
+{
+	double lStartMS = Platform::getTimeMS();
+	
+	size_t lNumWorlds = mWorlds.size();
+	size_t lBlockSize = (lNumWorlds + size_t(mNumThreads) - 1) / size_t(mNumThreads);
+	gJobSystem.parallelFor(0, lNumWorlds, lBlockSize, [this, lpControls, lNumSteps, lpObsOut](size_t lBegin, size_t lEnd)
+						   {
+							   runBlock(lBegin, lEnd, lpControls, lNumSteps, lpObsOut);
+						   });
+	
+	mTotalStepMS += Platform::getTimeMS() - lStartMS;
+	mTotalSteps += double(lNumSteps) * numWorlds();
+}
+
+//------------------------------------------------------------------------------
+
+void WorldBatch::runBlock(size_t lBegin, size_t lEnd, const float* lpControls, int lNumSteps, float* lpObsOut)
+{
+	for (size_t lWorldIndex = lBegin; lWorldIndex < lEnd; ++lWorldIndex)
+	{
+		World& lrWorld = *mWorlds[lWorldIndex];
+		const float* lpWorldControls = lpControls + lWorldIndex * kEnvNumControls;
+		lrWorld.input().setControls(lpWorldControls[kEnvControlAccel], lpWorldControls[kEnvControlSteer]);
+		for (int lStep = 0; lStep < lNumSteps; ++lStep)
+			lrWorld.step(mStepSec);
+		if (lpObsOut != nullptr)
+			observeWorld(int(lWorldIndex), lpObsOut + lWorldIndex * kEnvObsSize);
+	}
+}
+
+//------------------------------------------------------------------------------
+
+void WorldBatch::observe(float* lpObsOut) const
+{
+	for (int lWorldIndex = 0; lWorldIndex < numWorlds(); ++lWorldIndex)
+		observeWorld(lWorldIndex, lpObsOut + lWorldIndex * kEnvObsSize);
+}
+
+//------------------------------------------------------------------------------
+
+void WorldBatch::observeWorld(int lWorldIndex, float* lpObsOut) const
+{
+	const World& lrWorld = *mWorlds[lWorldIndex];
+	const PlayerCarEntity& lrPlayer = lrWorld.player();
+	const TargetEntity* lpTarget = lrWorld.currentTarget();
+	
+	lpObsOut[kEnvObsX]				= lrPlayer.x();
+	lpObsOut[kEnvObsY]				= lrPlayer.y();
+	lpObsOut[kEnvObsVelX]			= lrPlayer.velX();
+	lpObsOut[kEnvObsVelY]			= lrPlayer.velY();
+	lpObsOut[kEnvObsRotationRad]	= lrPlayer.rotationRad();
+	lpObsOut[kEnvObsCountdownSec]	= lrWorld.countdownSec();
+	lpObsOut[kEnvObsHaveTarget]		= lpTarget != nullptr ? 1.0f : 0.0f;
+	lpObsOut[kEnvObsTargetX]		= lpTarget != nullptr ? lpTarget->x() : 0.0f;
+	lpObsOut[kEnvObsTargetY]		= lpTarget != nullptr ? lpTarget->y() : 0.0f;
+	lpObsOut[kEnvObsCash]			= float(lrWorld.cash());
+}
+
+//------------------------------------------------------------------------------
+
+double WorldBatch::stepsPerSecPerThread() const
+{
+	if (mTotalStepMS <= 0.0)
+		return 0.0;
+	return mTotalSteps / (mTotalStepMS * 0.001) / mNumThreads;
+}
+
+//------------------------------------------------------------------------------
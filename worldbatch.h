@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+// WorldBatch: A set of worlds that are stepped together on the job system's
+//             threads, with controls in and observations out as flat float
+//             arrays.
+//             This is what envapi.h exposes.
+//
+// by Chris Bevan, 2013
+//------------------------------------------------------------------------------
+
+#ifndef WORLDBATCH_H
+#define WORLDBATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+class World;
+
+//------------------------------------------------------------------------------
+
+class WorldBatch
+{
+public:
+	// Zero or fewer threads means all of the job system's (one per core); it never uses more than that
+	WorldBatch(int lNumWorlds, uint32_t lBaseSeed, int lNumThreads);
+	~WorldBatch();
+	
+	int numWorlds() const { return int(mWorlds.size()); }
+	int numThreads() const { return mNumThreads; }
+	
+	void resetWorld(int lWorldIndex, uint32_t lSeed);
+	
+	// See envapi.h for the layouts.  Each job steps and then observes its own block of worlds, so nothing is shared
+	// between threads during a step.
+	void step(const float* lpControls, int lNumSteps, float* lpObsOut);
+	void observe(float* lpObsOut) const;
+	void observeWorld(int lWorldIndex, float* lpObsOut) const;
+	
+	double stepsPerSecPerThread() const;
+	
+private:
+	World* createWorld(uint32_t lSeed) const;
+	void runBlock(size_t lBegin, size_t lEnd, const float* lpControls, int lNumSteps, float* lpObsOut);
+	
+	std::vector<World*> mWorlds;
+	int mNumThreads;						// the number of blocks the worlds are split into
+	float mStepSec;
+	float mViewWidth, mViewHeight;
+	
+	double mTotalSteps;						// world steps, for the throughput figure
+	double mTotalStepMS;
+};
+
+//------------------------------------------------------------------------------
+
+#endif // WORLDBATCH_H